@@ -0,0 +1,180 @@
+#ifndef COOKED_TEXTURE_H
+#define COOKED_TEXTURE_H
+
+#include <learnopengl/mapped_file.h>
+#include <learnopengl/texture_compression.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+using namespace std;
+
+// directory (relative to the working directory) the asset cooker writes block compressed textures to
+const char *const COOKED_TEXTURE_DIRECTORY = "resources/cache/textures";
+
+// bump whenever the container layout or the encoders change, every cooked texture is then ignored until recooked
+const uint32_t COOKED_TEXTURE_VERSION = 4;
+const uint32_t COOKED_TEXTURE_MAGIC = 0x58544752; // "RGTX"
+
+// on-disk layout: header, level table, then the compressed levels back to back from the largest down to 1x1.
+// level offsets are relative to the start of the data section, so the whole chain can be staged with one copy.
+struct CookedTextureHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t sourceHash;        // hash of the source image, see CookedTextureCache::sourceHash
+    uint32_t codec;             // TextureCodec
+    uint32_t flipped;           // rows stored bottom first, like images loaded with flipVertically
+    uint32_t width;
+    uint32_t height;
+    uint32_t levelCount;
+    uint32_t srgb;              // mips averaged in linear light for sampling as sRGB, as stored otherwise
+    uint32_t role;              // TextureRole the codec and mip filter were chosen for
+    uint32_t reserved;
+    uint64_t levelOffset;
+    uint64_t dataOffset;
+    uint64_t dataSize;
+};
+
+struct CookedTextureLevel {
+    uint32_t width;
+    uint32_t height;
+    uint64_t offset;
+    uint64_t size;
+};
+
+// a validated cooked texture, pointing straight into the mapping
+struct CookedTextureView {
+    MappedFile file;
+    const CookedTextureHeader *header = nullptr;
+    const CookedTextureLevel *levels = nullptr;
+    const unsigned char *data = nullptr;
+
+    TextureCodec codec() const { return (TextureCodec)header->codec; }
+};
+
+class CookedTextureCache
+{
+public:
+    // key of a cooked texture: the contents of its source image. returns 0 when the source can't be read.
+    static uint64_t sourceHash(const string &path)
+    {
+        MappedFile source;
+        if (!source.open(path))
+            return 0;
+        uint64_t hash = HashBytes(&COOKED_TEXTURE_VERSION, sizeof(COOKED_TEXTURE_VERSION));
+        hash = HashBytes(source.data(), source.size(), hash);
+        return hash ? hash : 1;
+    }
+
+    // cooked files are named after the source contents instead of its path, so the cooker and the game find the same
+    // file no matter how they spell the path (and identical images are cooked once). a colour image sampled as sRGB
+    // and as stored needs mips built in different colour spaces, so each gets a file of its own
+    static string cachePath(uint64_t sourceHash, bool srgb)
+    {
+        char name[17];
+        snprintf(name, sizeof(name), "%016llx", (unsigned long long)sourceHash);
+        return string(COOKED_TEXTURE_DIRECTORY) + '/' + name + (srgb ? "-srgb" : "") + ".ctex";
+    }
+
+    // maps a cooked texture and checks it is complete and was cooked from the current source
+    static bool open(const string &path, uint64_t sourceHash, CookedTextureView &view)
+    {
+        if (sourceHash == 0 || !view.file.open(path))
+            return false;
+        const unsigned char *base = view.file.data();
+        size_t size = view.file.size();
+        if (size < sizeof(CookedTextureHeader))
+            return false;
+        const CookedTextureHeader *header = reinterpret_cast<const CookedTextureHeader *>(base);
+        if (header->magic != COOKED_TEXTURE_MAGIC || header->version != COOKED_TEXTURE_VERSION ||
+            header->sourceHash != sourceHash || header->levelCount == 0)
+            return false;
+        if (header->levelOffset % 8 != 0 || header->levelOffset > size ||
+            (uint64_t)header->levelCount * sizeof(CookedTextureLevel) > size - header->levelOffset ||
+            header->dataOffset > size || header->dataSize > size - header->dataOffset)
+            return false;
+
+        TextureCodec codec = (TextureCodec)header->codec;
+        if (codec != TextureCodec::BC1 && codec != TextureCodec::BC3 && codec != TextureCodec::BC4 && codec != TextureCodec::BC5)
+            return false;
+        if (header->role > (uint32_t)TextureRole::Specular || !TextureCodecFitsRole(codec, (TextureRole)header->role))
+            return false;
+        const CookedTextureLevel *levels = reinterpret_cast<const CookedTextureLevel *>(base + header->levelOffset);
+        for (uint32_t i = 0; i < header->levelCount; i++)
+        {
+            if (levels[i].offset > header->dataSize || levels[i].size > header->dataSize - levels[i].offset ||
+                levels[i].size != CompressedSize(codec, levels[i].width, levels[i].height))
+                return false;
+        }
+
+        view.header = header;
+        view.levels = levels;
+        view.data = base + header->dataOffset;
+        return true;
+    }
+
+    // writes a cooked texture to a temporary file and renames it into place, like ModelCache::write
+    static bool write(const string &path, uint64_t sourceHash, TextureCodec codec, TextureRole role, bool flipped,
+                      bool srgb, const vector<CompressedLevel> &levels)
+    {
+        if (sourceHash == 0 || levels.empty() || !MakeDirectories(path.substr(0, path.find_last_of('/'))))
+            return false;
+
+        vector<CookedTextureLevel> table;
+        uint64_t dataSize = 0;
+        for (const CompressedLevel &level : levels)
+        {
+            CookedTextureLevel entry;
+            entry.width = (uint32_t)level.width;
+            entry.height = (uint32_t)level.height;
+            entry.offset = dataSize;
+            entry.size = level.data.size();
+            table.push_back(entry);
+            dataSize += level.data.size();
+        }
+
+        CookedTextureHeader header;
+        memset(&header, 0, sizeof(header));
+        header.magic = COOKED_TEXTURE_MAGIC;
+        header.version = COOKED_TEXTURE_VERSION;
+        header.sourceHash = sourceHash;
+        header.codec = (uint32_t)codec;
+        header.flipped = flipped;
+        header.width = table[0].width;
+        header.height = table[0].height;
+        header.levelCount = (uint32_t)table.size();
+        header.srgb = srgb;
+        header.role = (uint32_t)role;
+        header.levelOffset = sizeof(CookedTextureHeader);
+        header.dataOffset = header.levelOffset + table.size() * sizeof(CookedTextureLevel);
+        header.dataSize = dataSize;
+
+        string temporaryPath = path + ".tmp";
+        {
+            ofstream out(temporaryPath, ios::binary | ios::trunc);
+            if (!out)
+                return false;
+            out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+            out.write(reinterpret_cast<const char *>(table.data()), table.size() * sizeof(CookedTextureLevel));
+            for (const CompressedLevel &level : levels)
+                out.write(reinterpret_cast<const char *>(level.data.data()), level.data.size());
+            if (!out)
+            {
+                out.close();
+                remove(temporaryPath.c_str());
+                return false;
+            }
+        }
+        if (rename(temporaryPath.c_str(), path.c_str()) != 0)
+        {
+            remove(temporaryPath.c_str());
+            return false;
+        }
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,140 @@
+#ifndef FRAME_UNIFORMS_H
+#define FRAME_UNIFORMS_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/gl_state.h>
+
+#include <cstddef>
+#include <cstring>
+#include <vector>
+using namespace std;
+
+// CPU mirrors of the std140 uniform blocks every shader shares (see SHARED_UNIFORM_BLOCKS in shader.h). std140
+// aligns a vec3 like a vec4 but lets a following float use its last four bytes, the padding members keep the offsets
+// in step.
+
+// layout (std140) uniform Frame: written once per frame
+struct FrameBlock {
+    glm::mat4 projection;
+    glm::mat4 view;
+    glm::vec3 viewPosition;
+    float time;                 // seconds since start, glfwGetTime
+};
+
+struct DirLightStd140 {
+    glm::vec3 direction;
+    float padding0;
+    glm::vec3 ambient;
+    float padding1;
+    glm::vec3 diffuse;
+    float padding2;
+    glm::vec3 specular;
+    float padding3;
+};
+
+// same member order as PointLight in the shaders
+struct PointLightStd140 {
+    glm::vec3 position;
+    float padding0;
+    glm::vec3 specular;
+    float padding1;
+    glm::vec3 diffuse;
+    float padding2;
+    glm::vec3 ambient;
+    float constant;
+    float linear;
+    float quadratic;
+    float padding3[2];
+};
+
+// layout (std140) uniform Lighting
+struct LightingBlock {
+    DirLightStd140 dirLight;
+    PointLightStd140 pointLight;
+};
+
+static_assert(offsetof(FrameBlock, viewPosition) == 128 && offsetof(FrameBlock, time) == 140 && sizeof(FrameBlock) == 144,
+              "FrameBlock has to match the std140 layout of the Frame block");
+static_assert(sizeof(DirLightStd140) == 64 && offsetof(PointLightStd140, constant) == 60 &&
+              offsetof(PointLightStd140, quadratic) == 68 && sizeof(PointLightStd140) == 80,
+              "the light structs have to match their std140 layout");
+static_assert(offsetof(LightingBlock, pointLight) == 64 && sizeof(LightingBlock) == 144,
+              "LightingBlock has to match the std140 layout of the Lighting block");
+
+// a uniform buffer holding one copy of a block per frame in flight. write() fills the next copy and binds it to the
+// block's binding point; the GPU can still be reading the previous copies, so each one is fenced and only waited
+// for (which practically never happens with three of them) when its turn comes round again.
+template <typename Block>
+class UniformRing
+{
+public:
+    UniformRing(GLuint binding, unsigned int frames = 3) : binding(binding), fences(frames, nullptr)
+    {
+        GLint alignment = 1;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        stride = (sizeof(Block) + alignment - 1) / alignment * alignment;
+        glGenBuffers(1, &buffer);
+        glState.bindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferData(GL_UNIFORM_BUFFER, stride * frames, nullptr, GL_DYNAMIC_DRAW);
+        glState.bindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    ~UniformRing()
+    {
+        for (GLsync fence : fences)
+            if (fence)
+                glDeleteSync(fence);
+        glState.deleteBuffers(1, &buffer);
+    }
+
+    UniformRing(const UniformRing &) = delete;
+    UniformRing &operator=(const UniformRing &) = delete;
+
+    void write(const Block &block)
+    {
+        // the draws that read the copy written last time are submitted by now
+        if (written)
+        {
+            if (fences[current])
+                glDeleteSync(fences[current]);
+            fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            current = (current + 1) % fences.size();
+        }
+        if (fences[current])
+        {
+            glClientWaitSync(fences[current], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+            glDeleteSync(fences[current]);
+            fences[current] = nullptr;
+        }
+
+        GLintptr offset = (GLintptr)(current * stride);
+        glState.bindBuffer(GL_UNIFORM_BUFFER, buffer);
+        void *mapped = glMapBufferRange(GL_UNIFORM_BUFFER, offset, sizeof(Block),
+                                        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        bool stored = false;
+        if (mapped)
+        {
+            memcpy(mapped, &block, sizeof(Block));
+            stored = glUnmapBuffer(GL_UNIFORM_BUFFER) == GL_TRUE;
+        }
+        // mapping failed (or the buffer got corrupted)
+        if (!stored)
+            glBufferSubData(GL_UNIFORM_BUFFER, offset, sizeof(Block), &block);
+        glState.bindBuffer(GL_UNIFORM_BUFFER, 0);
+        glState.bindBufferRange(GL_UNIFORM_BUFFER, binding, buffer, offset, sizeof(Block));
+        written = true;
+    }
+
+private:
+    GLuint binding;
+    GLuint buffer = 0;
+    size_t stride = 0;
+    vector<GLsync> fences;
+    size_t current = 0;
+    bool written = false;
+};
+
+#endif
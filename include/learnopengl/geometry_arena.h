@@ -0,0 +1,431 @@
+#ifndef GEOMETRY_ARENA_H
+#define GEOMETRY_ARENA_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/gl_state.h>
+#include <learnopengl/mesh_data.h>
+#include <learnopengl/vertex_format.h>
+
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <vector>
+using namespace std;
+
+void SetVertexAttributes(VertexLayout layout);
+void SetInstanceAttributes(size_t offset);
+size_t VertexSize(VertexLayout layout);
+
+// one GL buffer handed out in blocks. sizes are rounded up to the granularity, so offsets stay multiples of it (a
+// vertex stride, an index size). blocks are addressed through handles instead of offsets, which lets compact() move
+// them; when the buffer is full it is replaced by one twice the size and the contents are copied over on the GPU.
+class BufferPool
+{
+public:
+    static const unsigned int INVALID = UINT_MAX;
+
+    BufferPool(size_t granularity, size_t initialCapacity) : granularity(granularity)
+    {
+        capacity = roundUp(max(initialCapacity, granularity));
+        glGenBuffers(1, &buffer);
+        glState.bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, capacity, nullptr, GL_STATIC_DRAW);
+        freeRanges[0] = capacity;
+    }
+
+    ~BufferPool()
+    {
+        glState.deleteBuffers(1, &buffer);
+    }
+
+    BufferPool(const BufferPool &) = delete;
+    BufferPool &operator=(const BufferPool &) = delete;
+
+    // copies size bytes of data into a new block. may replace the buffer object, see id()
+    unsigned int allocate(const void *data, size_t size)
+    {
+        size = roundUp(max(size, (size_t)1));
+        auto range = findRange(size);
+        if (range == freeRanges.end())
+        {
+            grow(size);
+            range = findRange(size);
+        }
+        Block block;
+        block.offset = range->first;
+        block.size = size;
+        if (range->second > size)
+            freeRanges[range->first + size] = range->second - size;
+        freeRanges.erase(range);
+        used += size;
+
+        glState.bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, block.offset, size, data);
+
+        unsigned int handle;
+        if (!freeHandles.empty())
+        {
+            handle = freeHandles.back();
+            freeHandles.pop_back();
+            blocks[handle] = block;
+        }
+        else
+        {
+            handle = (unsigned int)blocks.size();
+            blocks.push_back(block);
+        }
+        return handle;
+    }
+
+    void free(unsigned int handle)
+    {
+        if (handle == INVALID || handle >= blocks.size() || blocks[handle].size == 0)
+            return;
+        Block &block = blocks[handle];
+        used -= block.size;
+        // give the range back, merged with its free neighbours
+        size_t offset = block.offset, size = block.size;
+        auto next = freeRanges.lower_bound(offset);
+        if (next != freeRanges.end() && next->first == offset + size)
+        {
+            size += next->second;
+            next = freeRanges.erase(next);
+        }
+        if (next != freeRanges.begin())
+        {
+            auto previous = std::prev(next);
+            if (previous->first + previous->second == offset)
+            {
+                offset = previous->first;
+                size += previous->second;
+                freeRanges.erase(previous);
+            }
+        }
+        freeRanges[offset] = size;
+        block.size = 0;
+        freeHandles.push_back(handle);
+    }
+
+    // moves every live block to the front of a fresh buffer, in offset order, so the free space is one range at the end.
+    // returns false when there was nothing to close up.
+    bool compact()
+    {
+        if (freeRanges.size() <= 1 && (freeRanges.empty() || freeRanges.begin()->first + freeRanges.begin()->second == capacity))
+            return false;
+        vector<unsigned int> live;
+        for (unsigned int handle = 0; handle < blocks.size(); handle++)
+            if (blocks[handle].size)
+                live.push_back(handle);
+        sort(live.begin(), live.end(), [this](unsigned int a, unsigned int b) { return blocks[a].offset < blocks[b].offset; });
+
+        GLuint packed = createBuffer(capacity);
+        glState.bindBuffer(GL_COPY_READ_BUFFER, buffer);
+        glState.bindBuffer(GL_COPY_WRITE_BUFFER, packed);
+        size_t offset = 0;
+        for (unsigned int handle : live)
+        {
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, blocks[handle].offset, offset, blocks[handle].size);
+            blocks[handle].offset = offset;
+            offset += blocks[handle].size;
+        }
+        glState.deleteBuffers(1, &buffer);
+        buffer = packed;
+        freeRanges.clear();
+        if (offset < capacity)
+            freeRanges[offset] = capacity - offset;
+        return true;
+    }
+
+    size_t offset(unsigned int handle) const { return blocks[handle].offset; }
+    GLuint id() const { return buffer; }
+    size_t bytesUsed() const { return used; }
+    size_t bytesReserved() const { return capacity; }
+    // separate free ranges; anything but one range at the end is space compact() can win back
+    size_t fragments() const { return freeRanges.size(); }
+
+private:
+    struct Block {
+        size_t offset = 0;
+        size_t size = 0;    // 0 for a freed handle
+    };
+
+    GLuint buffer = 0;
+    size_t granularity;
+    size_t capacity = 0;
+    size_t used = 0;
+    vector<Block> blocks;
+    vector<unsigned int> freeHandles;
+    map<size_t, size_t> freeRanges;     // offset -> size
+
+    size_t roundUp(size_t size) const
+    {
+        return (size + granularity - 1) / granularity * granularity;
+    }
+
+    // first fit: blocks come and go with whole models, which leaves few and large holes
+    map<size_t, size_t>::iterator findRange(size_t size)
+    {
+        for (auto range = freeRanges.begin(); range != freeRanges.end(); ++range)
+            if (range->second >= size)
+                return range;
+        return freeRanges.end();
+    }
+
+    static GLuint createBuffer(size_t size)
+    {
+        GLuint id;
+        glGenBuffers(1, &id);
+        glState.bindBuffer(GL_COPY_WRITE_BUFFER, id);
+        glBufferData(GL_COPY_WRITE_BUFFER, size, nullptr, GL_STATIC_DRAW);
+        return id;
+    }
+
+    void grow(size_t needed)
+    {
+        size_t grown = max(capacity * 2, roundUp(capacity + needed));
+        GLuint bigger = createBuffer(grown);
+        glState.bindBuffer(GL_COPY_READ_BUFFER, buffer);
+        glState.bindBuffer(GL_COPY_WRITE_BUFFER, bigger);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, capacity);
+        glState.deleteBuffers(1, &buffer);
+        buffer = bigger;
+
+        // extend the free range touching the old end, if there is one
+        size_t start = capacity;
+        if (!freeRanges.empty())
+        {
+            auto last = std::prev(freeRanges.end());
+            if (last->first + last->second == capacity)
+            {
+                start = last->first;
+                freeRanges.erase(last);
+            }
+        }
+        freeRanges[start] = grown - start;
+        capacity = grown;
+    }
+};
+
+// where a mesh lives inside a GeometryArena: one block per pool, INVALID for a pool it doesn't use
+struct GeometryAllocation {
+    VertexLayout layout = VertexLayout::Compact;
+    unsigned int vertices = BufferPool::INVALID;
+    unsigned int indices = BufferPool::INVALID;
+    unsigned int instances = BufferPool::INVALID;
+};
+
+// shared home for the geometry of every model: the vertices of each vertex layout, all indices and all instance
+// transforms are suballocated from one buffer each, with one vertex array object per layout. meshes in the arena are
+// drawn with glDrawElementsBaseVertex at their offsets, so consecutive meshes of the same layout need no VAO switch.
+// offsets move when blocks are freed and compacted, so meshes look them up through their GeometryAllocation every draw.
+class GeometryArena
+{
+public:
+    GeometryArena() {}
+
+    ~GeometryArena()
+    {
+        for (Format &format : formats)
+            if (format.vertexArray)
+                glState.deleteVertexArrays(1, &format.vertexArray);
+    }
+
+    GeometryArena(const GeometryArena &) = delete;
+    GeometryArena &operator=(const GeometryArena &) = delete;
+
+    // vertex data has to be in layout already, index data is 2 or 4 bytes per index (see PackIndices)
+    GeometryAllocation allocate(VertexLayout layout, const void *vertices, size_t vertexBytes, const void *indices, size_t indexBytes,
+                                const vector<glm::mat4> &instanceTransforms)
+    {
+        Format &format = formats[(int)layout];
+        if (!format.vertices)
+            format.vertices.reset(new BufferPool(VertexSize(layout), 4 * 1024 * 1024));
+        if (!indexPool)
+            indexPool.reset(new BufferPool(4, 1024 * 1024));
+
+        GeometryAllocation allocation;
+        allocation.layout = layout;
+        allocation.vertices = format.vertices->allocate(vertices, vertexBytes);
+        allocation.indices = indexPool->allocate(indices, indexBytes);
+        if (!instanceTransforms.empty())
+        {
+            if (!instancePool)
+                instancePool.reset(new BufferPool(sizeof(glm::mat4), 64 * 1024));
+            allocation.instances = instancePool->allocate(&instanceTransforms[0], instanceTransforms.size() * sizeof(glm::mat4));
+        }
+        // growing may have replaced a buffer object the vertex arrays point at
+        updateVertexArrays();
+        allocations++;
+        return allocation;
+    }
+
+    void free(GeometryAllocation &allocation)
+    {
+        if (allocation.vertices == BufferPool::INVALID)
+            return;
+        formats[(int)allocation.layout].vertices->free(allocation.vertices);
+        indexPool->free(allocation.indices);
+        if (instancePool)
+            instancePool->free(allocation.instances);
+        allocation = GeometryAllocation();
+        allocations--;
+    }
+
+    // closes the holes freed allocations left behind. meshes keep working, their allocations only change offsets
+    void compact()
+    {
+        bool changed = false;
+        for (Format &format : formats)
+            if (format.vertices)
+                changed |= format.vertices->compact();
+        if (indexPool)
+            changed |= indexPool->compact();
+        if (instancePool)
+            changed |= instancePool->compact();
+        if (changed)
+        {
+            updateVertexArrays();
+            generation++;
+        }
+    }
+
+    // changes whenever allocations move, for callers that keep offsets around (see Model::DrawIndirect)
+    unsigned int layoutGeneration() const { return generation; }
+
+    GLuint vertexArray(const GeometryAllocation &allocation) const
+    {
+        return formats[(int)allocation.layout].vertexArray;
+    }
+
+    GLint baseVertex(const GeometryAllocation &allocation) const
+    {
+        return (GLint)(formats[(int)allocation.layout].vertices->offset(allocation.vertices) / VertexSize(allocation.layout));
+    }
+
+    // byte offset of the allocation's first index in the shared index buffer
+    size_t indexOffset(const GeometryAllocation &allocation) const
+    {
+        return indexPool->offset(allocation.indices);
+    }
+
+    // points the per instance attributes of the bound vertex array at the allocation's transforms. there is no base
+    // instance in GL 3.3, so this is the one piece of vertex array state that changes between meshes.
+    void bindInstances(const GeometryAllocation &allocation)
+    {
+        glState.bindBuffer(GL_ARRAY_BUFFER, instancePool->id());
+        SetInstanceAttributes(instancePool->offset(allocation.instances));
+    }
+
+    void report() const
+    {
+        size_t used = 0, reserved = 0, fragments = 0, buffers = 0;
+        auto add = [&](const unique_ptr<BufferPool> &pool)
+        {
+            if (!pool)
+                return;
+            used += pool->bytesUsed();
+            reserved += pool->bytesReserved();
+            fragments += pool->fragments();
+            buffers++;
+        };
+        for (const Format &format : formats)
+            add(format.vertices);
+        add(indexPool);
+        add(instancePool);
+        std::cout << "GEOMETRY_ARENA:: " << allocations << " meshes in " << buffers << " buffers, " << used / 1024 << " KB used of "
+                  << reserved / 1024 << " KB, " << fragments << " free ranges" << std::endl;
+    }
+
+private:
+    struct Format {
+        unique_ptr<BufferPool> vertices;
+        GLuint vertexArray = 0;
+    };
+
+    Format formats[2];      // indexed by VertexLayout
+    unique_ptr<BufferPool> indexPool;
+    unique_ptr<BufferPool> instancePool;
+    unsigned int allocations = 0;
+    unsigned int generation = 0;
+
+    void updateVertexArrays()
+    {
+        for (int layout = 0; layout < 2; layout++)
+        {
+            Format &format = formats[layout];
+            if (!format.vertices)
+                continue;
+            if (!format.vertexArray)
+                glGenVertexArrays(1, &format.vertexArray);
+            glState.bindVertexArray(format.vertexArray);
+            glState.bindBuffer(GL_ARRAY_BUFFER, format.vertices->id());
+            SetVertexAttributes((VertexLayout)layout);
+            glState.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexPool->id());
+            if (instancePool)
+            {
+                glState.bindBuffer(GL_ARRAY_BUFFER, instancePool->id());
+                SetInstanceAttributes(0);
+            }
+        }
+        glState.bindVertexArray(0);
+    }
+};
+
+// vertex attribute pointers 0-4 for vertices in layout, read from the buffer bound to GL_ARRAY_BUFFER
+void SetVertexAttributes(VertexLayout layout)
+{
+    if (layout == VertexLayout::Compact)
+    {
+        // normalized attributes do the decoding, see PackedVertex. there is no bitangent attribute,
+        // shaders reading location 4 get the default (0, 0, 0, 1) and have to use cross(N, T) * tangent.w
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, position));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, normal));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, texCoords));
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, tangent));
+        return;
+    }
+    // vertex Positions
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+    // vertex normals
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+    // vertex texture coords
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+    // vertex tangent
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
+    // vertex bitangent
+    glEnableVertexAttribArray(4);
+    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+}
+
+// per instance transform attributes 5-8, read from the buffer bound to GL_ARRAY_BUFFER starting at offset
+void SetInstanceAttributes(size_t offset)
+{
+    // a mat4 attribute takes four locations, one per column
+    for (unsigned int column = 0; column < 4; column++)
+    {
+        glEnableVertexAttribArray(5 + column);
+        glVertexAttribPointer(5 + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(offset + column * sizeof(glm::vec4)));
+        glVertexAttribDivisor(5 + column, 1);
+    }
+}
+
+size_t VertexSize(VertexLayout layout)
+{
+    return layout == VertexLayout::Compact ? sizeof(PackedVertex) : sizeof(Vertex);
+}
+
+#endif
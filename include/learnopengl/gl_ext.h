@@ -0,0 +1,111 @@
+#ifndef GL_EXT_H
+#define GL_EXT_H
+
+#include <glad/glad.h>
+
+#include <cstring>
+
+// glad is generated for the 3.3 core profile without extensions. whatever we use beyond that is declared here
+// and has to be checked for at runtime with HasGLExtension.
+
+// EXT_texture_compression_s3tc
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+// EXT_texture_sRGB, sRGB variants of the S3TC formats
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+
+// ARB_draw_indirect (core in 4.0), ARB_multi_draw_indirect (4.3) and ARB_base_instance (4.2).
+// the function pointer is loaded by LoadGLExtensions, typedef'd under our own name so a glad regenerated for a newer
+// version doesn't clash with it
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+typedef void (APIENTRYP MultiDrawElementsIndirectProc)(GLenum mode, GLenum type, const void *indirect, GLsizei drawcount, GLsizei stride);
+
+// ARB_get_program_binary (core in 4.1)
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+typedef void (APIENTRYP GetProgramBinaryProc)(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary);
+typedef void (APIENTRYP ProgramBinaryProc)(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length);
+typedef void (APIENTRYP ProgramParameteriProc)(GLuint program, GLenum pname, GLint value);
+
+// KHR_parallel_shader_compile, or the ARB extension it came from (same enum, entry point with the ARB suffix)
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+typedef void (APIENTRYP MaxShaderCompilerThreadsProc)(GLuint count);
+
+// one draw of glMultiDrawElementsIndirect, laid out as the GL expects it in the GL_DRAW_INDIRECT_BUFFER
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;      // in indices, not bytes
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+// extension entry points, null / false until LoadGLExtensions found them
+struct GLExtensionFunctions {
+    bool multiDrawIndirect = false;     // multi draw indirect with base instance
+    MultiDrawElementsIndirectProc multiDrawElementsIndirect = nullptr;
+    bool programBinaries = false;       // get/load program binaries, in at least one format
+    GetProgramBinaryProc getProgramBinary = nullptr;
+    ProgramBinaryProc programBinary = nullptr;
+    ProgramParameteriProc programParameteri = nullptr;
+    bool parallelShaderCompile = false; // compile in the background, completion can be polled
+    MaxShaderCompilerThreadsProc maxShaderCompilerThreads = nullptr;
+};
+GLExtensionFunctions glExtensions;
+
+bool HasGLExtension(const char *name);
+void LoadGLExtensions(GLADloadproc load);
+
+// needs a current context
+bool HasGLExtension(const char *name)
+{
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; i++)
+    {
+        const char *extension = reinterpret_cast<const char *>(glGetStringi(GL_EXTENSIONS, (GLuint)i));
+        if (extension && strcmp(extension, name) == 0)
+            return true;
+    }
+    return false;
+}
+
+// call once after gladLoadGLLoader, with the same loader
+void LoadGLExtensions(GLADloadproc load)
+{
+    if (HasGLExtension("GL_ARB_multi_draw_indirect") && HasGLExtension("GL_ARB_base_instance"))
+    {
+        glExtensions.multiDrawElementsIndirect = (MultiDrawElementsIndirectProc)load("glMultiDrawElementsIndirect");
+        glExtensions.multiDrawIndirect = glExtensions.multiDrawElementsIndirect != nullptr;
+    }
+    if (HasGLExtension("GL_ARB_get_program_binary"))
+    {
+        glExtensions.getProgramBinary = (GetProgramBinaryProc)load("glGetProgramBinary");
+        glExtensions.programBinary = (ProgramBinaryProc)load("glProgramBinary");
+        glExtensions.programParameteri = (ProgramParameteriProc)load("glProgramParameteri");
+        // some drivers expose the extension but no format to save programs in
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        glExtensions.programBinaries = glExtensions.getProgramBinary && glExtensions.programBinary &&
+                                       glExtensions.programParameteri && formats > 0;
+    }
+    if (HasGLExtension("GL_KHR_parallel_shader_compile"))
+        glExtensions.maxShaderCompilerThreads = (MaxShaderCompilerThreadsProc)load("glMaxShaderCompilerThreadsKHR");
+    else if (HasGLExtension("GL_ARB_parallel_shader_compile"))
+        glExtensions.maxShaderCompilerThreads = (MaxShaderCompilerThreadsProc)load("glMaxShaderCompilerThreadsARB");
+    glExtensions.parallelShaderCompile = glExtensions.maxShaderCompilerThreads != nullptr;
+}
+
+#endif
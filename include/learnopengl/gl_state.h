@@ -0,0 +1,267 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/gl_ext.h>
+
+// texture units whose bindings are tracked; binds on higher units always reach GL
+const unsigned int GL_STATE_TEXTURE_UNITS = 16;
+// a binding the cache doesn't know, after invalidate() or where GL changes it on its own
+const GLuint GL_STATE_UNKNOWN = 0xffffffffu;
+
+// calls GLStateCache passed on to GL and calls it dropped because they wouldn't have changed anything
+struct GLStateStats {
+    unsigned long issued = 0;
+    unsigned long elided = 0;
+};
+
+// shadow copy of the GL state the renderer keeps switching: the program, the vertex array, the textures of each unit,
+// the generic buffer bindings, and the depth, cull and blend state. a call that would set what is already set is
+// dropped. only correct as long as every change of that state goes through here, so code that changes it behind the
+// cache's back (ImGui) has to be followed by invalidate(). needs the GL context's thread like any GL call.
+class GLStateCache
+{
+public:
+    GLStateCache() { invalidate(); }
+
+    GLStateCache(const GLStateCache &) = delete;
+    GLStateCache &operator=(const GLStateCache &) = delete;
+
+    void useProgram(GLuint program)
+    {
+        if (update(currentProgram, program))
+            glUseProgram(program);
+    }
+
+    // the element array buffer binding belongs to the vertex array, so it isn't known after switching
+    void bindVertexArray(GLuint vertexArray)
+    {
+        if (!update(currentVertexArray, vertexArray))
+            return;
+        glBindVertexArray(vertexArray);
+        buffers[bufferSlot(GL_ELEMENT_ARRAY_BUFFER)] = GL_STATE_UNKNOWN;
+    }
+
+    void activeTexture(unsigned int unit)
+    {
+        if (update(activeUnit, unit))
+            glActiveTexture(GL_TEXTURE0 + unit);
+    }
+
+    // binds on unit, making it the active unit only when the bind has to happen
+    void bindTexture(unsigned int unit, GLenum target, GLuint texture)
+    {
+        int slot = textureSlot(target);
+        bool tracked = slot >= 0 && unit < GL_STATE_TEXTURE_UNITS;
+        if (tracked && textures[unit][slot] == texture)
+        {
+            stats.elided++;
+            return;
+        }
+        activeTexture(unit);
+        glBindTexture(target, texture);
+        stats.issued++;
+        if (tracked)
+            textures[unit][slot] = texture;
+    }
+
+    // binds on whichever unit is active, for code creating or filling textures
+    void bindTexture(GLenum target, GLuint texture)
+    {
+        bindTexture(activeUnit == GL_STATE_UNKNOWN ? 0 : activeUnit, target, texture);
+    }
+
+    void bindBuffer(GLenum target, GLuint buffer)
+    {
+        int slot = bufferSlot(target);
+        if (slot < 0)
+        {
+            glBindBuffer(target, buffer);
+            stats.issued++;
+            return;
+        }
+        if (update(buffers[slot], buffer))
+            glBindBuffer(target, buffer);
+    }
+
+    // the indexed binding always changes, but it also moves the generic binding of target
+    void bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+    {
+        glBindBufferRange(target, index, buffer, offset, size);
+        stats.issued++;
+        int slot = bufferSlot(target);
+        if (slot >= 0)
+            buffers[slot] = buffer;
+    }
+
+    void setEnabled(GLenum capability, bool enabled)
+    {
+        int slot = capabilitySlot(capability);
+        if (slot >= 0 && !update(capabilities[slot], enabled ? 1u : 0u))
+            return;
+        if (slot < 0)
+            stats.issued++;
+        if (enabled)
+            glEnable(capability);
+        else
+            glDisable(capability);
+    }
+    void enable(GLenum capability) { setEnabled(capability, true); }
+    void disable(GLenum capability) { setEnabled(capability, false); }
+
+    void depthFunc(GLenum func)
+    {
+        if (update(currentDepthFunc, func))
+            glDepthFunc(func);
+    }
+
+    void cullFace(GLenum mode)
+    {
+        if (update(currentCullFace, mode))
+            glCullFace(mode);
+    }
+
+    void blendFunc(GLenum source, GLenum destination)
+    {
+        if (blendSource == source && blendDestination == destination)
+        {
+            stats.elided++;
+            return;
+        }
+        blendSource = source;
+        blendDestination = destination;
+        glBlendFunc(source, destination);
+        stats.issued++;
+    }
+
+    // deleting an object unbinds it, and GL may hand its name out again: bindings of it are forgotten with it
+    void deleteProgram(GLuint program)
+    {
+        glDeleteProgram(program);
+        if (currentProgram == program)
+            currentProgram = GL_STATE_UNKNOWN;
+    }
+
+    void deleteVertexArrays(GLsizei count, const GLuint *vertexArrays)
+    {
+        glDeleteVertexArrays(count, vertexArrays);
+        for (GLsizei i = 0; i < count; i++)
+            if (currentVertexArray == vertexArrays[i])
+                currentVertexArray = GL_STATE_UNKNOWN;
+    }
+
+    void deleteBuffers(GLsizei count, const GLuint *deleted)
+    {
+        glDeleteBuffers(count, deleted);
+        for (GLsizei i = 0; i < count; i++)
+            for (GLuint &buffer : buffers)
+                if (buffer == deleted[i])
+                    buffer = GL_STATE_UNKNOWN;
+    }
+
+    void deleteTextures(GLsizei count, const GLuint *deleted)
+    {
+        glDeleteTextures(count, deleted);
+        for (GLsizei i = 0; i < count; i++)
+            for (auto &unit : textures)
+                for (GLuint &texture : unit)
+                    if (texture == deleted[i])
+                        texture = GL_STATE_UNKNOWN;
+    }
+
+    // forgets everything, the next call of each kind reaches GL
+    void invalidate()
+    {
+        currentProgram = currentVertexArray = activeUnit = GL_STATE_UNKNOWN;
+        for (auto &unit : textures)
+            for (GLuint &texture : unit)
+                texture = GL_STATE_UNKNOWN;
+        for (GLuint &buffer : buffers)
+            buffer = GL_STATE_UNKNOWN;
+        for (GLuint &capability : capabilities)
+            capability = GL_STATE_UNKNOWN;
+        currentDepthFunc = currentCullFace = blendSource = blendDestination = GL_STATE_UNKNOWN;
+    }
+
+    // call once a frame; lastFrame() then has the counts of the frame just finished
+    void endFrame()
+    {
+        previous = stats;
+        stats = GLStateStats();
+    }
+
+    const GLStateStats &lastFrame() const { return previous; }
+
+private:
+    static const unsigned int TEXTURE_TARGETS = 3;
+    static const unsigned int BUFFER_TARGETS = 7;
+    static const unsigned int CAPABILITIES = 3;
+
+    GLuint currentProgram;
+    GLuint currentVertexArray;
+    GLuint activeUnit;
+    GLuint textures[GL_STATE_TEXTURE_UNITS][TEXTURE_TARGETS];
+    GLuint buffers[BUFFER_TARGETS];
+    GLuint capabilities[CAPABILITIES];      // 0 disabled, 1 enabled
+    GLenum currentDepthFunc;
+    GLenum currentCullFace;
+    GLenum blendSource;
+    GLenum blendDestination;
+
+    GLStateStats stats;
+    GLStateStats previous;
+
+    // counts the call, and whether it has to be made
+    bool update(GLuint &tracked, GLuint value)
+    {
+        if (tracked == value)
+        {
+            stats.elided++;
+            return false;
+        }
+        tracked = value;
+        stats.issued++;
+        return true;
+    }
+
+    static int textureSlot(GLenum target)
+    {
+        switch (target)
+        {
+        case GL_TEXTURE_2D: return 0;
+        case GL_TEXTURE_2D_ARRAY: return 1;
+        case GL_TEXTURE_CUBE_MAP: return 2;
+        default: return -1;
+        }
+    }
+
+    static int bufferSlot(GLenum target)
+    {
+        switch (target)
+        {
+        case GL_ARRAY_BUFFER: return 0;
+        case GL_ELEMENT_ARRAY_BUFFER: return 1;
+        case GL_UNIFORM_BUFFER: return 2;
+        case GL_COPY_READ_BUFFER: return 3;
+        case GL_COPY_WRITE_BUFFER: return 4;
+        case GL_DRAW_INDIRECT_BUFFER: return 5;
+        case GL_PIXEL_UNPACK_BUFFER: return 6;
+        default: return -1;
+        }
+    }
+
+    static int capabilitySlot(GLenum capability)
+    {
+        switch (capability)
+        {
+        case GL_DEPTH_TEST: return 0;
+        case GL_CULL_FACE: return 1;
+        case GL_BLEND: return 2;
+        default: return -1;
+        }
+    }
+};
+GLStateCache glState;
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include <stb_image.h>
+
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+using namespace std;
+
+// pixels of an image file decoded by stb_image, released with stbi_image_free
+struct DecodedImage {
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+    int bytesPerChannel = 1;    // 2 for 16 bit images, the pixels are then unsigned shorts
+    unique_ptr<unsigned char, void (*)(void *)> pixels{nullptr, stbi_image_free};
+
+    size_t size() const { return (size_t)width * height * channels * bytesPerChannel; }
+};
+
+DecodedImage DecodeImage(const string &filename, bool flipVertically, int desiredChannels = 0, bool keepSixteenBit = false);
+bool IsSixteenBitPng(const string &filename);
+bool ReadImageInfo(const string &filename, int &width, int &height, int &channels);
+
+// decodes an image file without touching OpenGL, so it is safe on worker threads.
+// stb_image's flip setting is a process wide global that can't be changed safely while other threads
+// decode, so it is left alone and the rows are flipped here instead.
+// desiredChannels converts to that many channels, 0 keeps what the file has. with keepSixteenBit 16 bit PNGs are
+// returned as they are instead of being reduced to 8 bit.
+DecodedImage DecodeImage(const string &filename, bool flipVertically, int desiredChannels, bool keepSixteenBit)
+{
+    DecodedImage image;
+    if (keepSixteenBit && IsSixteenBitPng(filename))
+    {
+        image.bytesPerChannel = 2;
+        image.pixels.reset(reinterpret_cast<unsigned char *>(stbi_load_16(filename.c_str(), &image.width, &image.height, &image.channels, desiredChannels)));
+    }
+    else
+        image.pixels.reset(stbi_load(filename.c_str(), &image.width, &image.height, &image.channels, desiredChannels));
+    if (desiredChannels)
+        image.channels = desiredChannels;
+    if (image.pixels && flipVertically)
+    {
+        size_t rowSize = (size_t)image.width * image.channels * image.bytesPerChannel;
+        vector<unsigned char> row(rowSize);
+        unsigned char *top = image.pixels.get();
+        unsigned char *bottom = top + (size_t)(image.height - 1) * rowSize;
+        for (; top < bottom; top += rowSize, bottom -= rowSize)
+        {
+            memcpy(row.data(), top, rowSize);
+            memcpy(top, bottom, rowSize);
+            memcpy(bottom, row.data(), rowSize);
+        }
+    }
+    return image;
+}
+
+// this stb_image has no stbi_is_16_bit yet, so the bit depth is read from the PNG header (IHDR always comes first)
+bool IsSixteenBitPng(const string &filename)
+{
+    static const unsigned char signature[8] = {137, 'P', 'N', 'G', '\r', '\n', 26, '\n'};
+    unsigned char header[25];
+    ifstream file(filename, ios::binary);
+    if (!file.read(reinterpret_cast<char *>(header), sizeof(header)))
+        return false;
+    return memcmp(header, signature, sizeof(signature)) == 0 && memcmp(header + 12, "IHDR", 4) == 0 && header[24] == 16;
+}
+
+// size and channel count from the file header, without decoding the pixels
+bool ReadImageInfo(const string &filename, int &width, int &height, int &channels)
+{
+    return stbi_info(filename.c_str(), &width, &height, &channels) != 0;
+}
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+using namespace std;
+
+// read-only memory mapping of a whole file, unmapped when the object goes away
+class MappedFile
+{
+public:
+    MappedFile() : mData(nullptr), mSize(0) {}
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool open(const string &path)
+    {
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size <= 0)
+        {
+            ::close(fd);
+            return false;
+        }
+        void *data = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        // the mapping stays valid after the descriptor is closed
+        ::close(fd);
+        if (data == MAP_FAILED)
+            return false;
+        mData = static_cast<const unsigned char *>(data);
+        mSize = (size_t)info.st_size;
+        return true;
+    }
+
+    void close()
+    {
+        if (mData)
+            munmap(const_cast<unsigned char *>(mData), mSize);
+        mData = nullptr;
+        mSize = 0;
+    }
+
+    const unsigned char *data() const { return mData; }
+    size_t size() const { return mSize; }
+
+private:
+    const unsigned char *mData;
+    size_t mSize;
+};
+
+// 64 bit FNV-1a, good enough to detect changed or duplicated files; not meant to be collision resistant
+inline uint64_t HashBytes(const void *data, size_t size, uint64_t hash = 14695981039346656037ULL)
+{
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// hash of a whole file's contents, 0 when it can't be read
+inline uint64_t HashFile(const string &path)
+{
+    MappedFile file;
+    if (!file.open(path))
+        return 0;
+    uint64_t hash = HashBytes(file.data(), file.size());
+    return hash ? hash : 1;
+}
+
+// size of a file in bytes, 0 when it can't be read
+inline size_t FileSize(const string &path)
+{
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0 || info.st_size <= 0)
+        return 0;
+    return (size_t)info.st_size;
+}
+
+// mkdir -p
+inline bool MakeDirectories(const string &path)
+{
+    for (size_t slash = path.find('/', 1); ; slash = path.find('/', slash + 1))
+    {
+        string prefix = path.substr(0, slash);
+        if (mkdir(prefix.c_str(), 0755) != 0 && errno != EEXIST)
+            return false;
+        if (slash == string::npos)
+            return true;
+    }
+}
+
+#endif
@@ -0,0 +1,191 @@
+#ifndef MATERIAL_H
+#define MATERIAL_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/gl_state.h>
+#include <learnopengl/shader.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+struct Texture {
+    unsigned int id;
+    string type;
+    string path;
+};
+
+// material texture types that Model::upload packs into texture arrays, in the order of the sampler tables below.
+// the samplers are named after the type, "texture_diffuse_array" and so on.
+const unsigned int MATERIAL_TEXTURE_TYPE_COUNT = 4;
+const char *const MATERIAL_TEXTURE_TYPES[MATERIAL_TEXTURE_TYPE_COUNT] = {
+    "texture_diffuse", "texture_specular", "texture_normal", "texture_height"
+};
+// the arrays are bound from this unit on, above the units of the 2D textures so the two sampler types never share one
+const unsigned int MATERIAL_ARRAY_UNIT = 8;
+const unsigned int MATERIAL_UNIT_COUNT = MATERIAL_ARRAY_UNIT + MATERIAL_TEXTURE_TYPE_COUNT;
+static_assert(MATERIAL_UNIT_COUNT <= GL_STATE_TEXTURE_UNITS, "glState has to track every unit a material binds");
+
+// samplers of 2D textures that get handles, texture_diffuse1 to texture_diffuse4 and so on
+const unsigned int MATERIAL_SAMPLERS_PER_TYPE = 4;
+
+// what light.fs used to be given for every mesh; the importer doesn't read material constants
+const float MATERIAL_DEFAULT_SHININESS = 32.0f;
+
+// handles of the uniforms a material sets, resolved when the shader (or the sampler name prefix) changes
+struct MaterialUniforms {
+    Uniform<int> samplers[MATERIAL_TEXTURE_TYPE_COUNT][MATERIAL_SAMPLERS_PER_TYPE];
+    Uniform<int> arraySamplers[MATERIAL_TEXTURE_TYPE_COUNT];
+    Uniform<bool> textureArrays;
+    Uniform<glm::ivec4> layers;
+    Uniform<float> shininess;
+
+    void resolve(const Shader &shader, const string &prefix)
+    {
+        for (unsigned int type = 0; type < MATERIAL_TEXTURE_TYPE_COUNT; type++)
+        {
+            for (unsigned int number = 0; number < MATERIAL_SAMPLERS_PER_TYPE; number++)
+                samplers[type][number] = shader.uniform<int>(prefix + MATERIAL_TEXTURE_TYPES[type] + to_string(number + 1));
+            arraySamplers[type] = shader.uniform<int>(prefix + MATERIAL_TEXTURE_TYPES[type] + "_array");
+        }
+        textureArrays = shader.uniform<bool>("meshTextureArrays");
+        layers = shader.uniform<glm::ivec4>("meshMaterialLayers");
+        shininess = shader.uniform<float>(prefix + "shininess");
+    }
+};
+
+// one texture of a material: where it is bound and which sampler reads it
+struct MaterialTexture {
+    GLenum target;              // GL_TEXTURE_2D or GL_TEXTURE_2D_ARRAY
+    GLuint texture;
+    unsigned int unit;
+    unsigned int type;          // MATERIAL_TEXTURE_TYPES entry
+    int number;                 // texture_diffuse1 is 0; -1 for the type's array sampler, which never moves
+};
+
+class Material;
+
+// which material consecutive draws of one program bound last; the textures on the units are glState's business
+struct MaterialBindState {
+    const Material *material = nullptr;
+
+    // puts the render state back the way main set it up: main enables face culling once, materials switch it off
+    // and on around themselves
+    void restore()
+    {
+        glState.enable(GL_CULL_FACE);
+    }
+};
+
+// how a mesh's surface is drawn, built once when the model is uploaded: the texture of every unit and the sampler
+// pointed at it, the layers of the texture arrays, the numeric parameters and the render state. binding one walks
+// its tables without any string handling, and nothing at all when it's the material bound last.
+class Material
+{
+public:
+    vector<MaterialTexture> textures;
+    // with textureArrays the textures are layers of arrays shared with the other materials of the model, one array
+    // per MATERIAL_TEXTURE_TYPES entry and layers says which layer to sample
+    bool textureArrays = false;
+    glm::ivec4 layers = glm::ivec4(0);
+    float shininess = MATERIAL_DEFAULT_SHININESS;
+    bool cullFace = true;
+
+    // 2D textures on consecutive units; the Nth texture of a type goes to the sampler named after the type plus N
+    static Material FromTextures(const vector<Texture> &textures)
+    {
+        Material material;
+        unsigned int samplerCounts[MATERIAL_TEXTURE_TYPE_COUNT] = {};
+        for (unsigned int i = 0; i < textures.size(); i++)
+        {
+            if (i >= MATERIAL_ARRAY_UNIT)
+            {
+                cout << "WARNING::MATERIAL:: more than " << MATERIAL_ARRAY_UNIT << " textures, " << textures[i].path
+                     << " is left out" << endl;
+                continue;
+            }
+            unsigned int type = 0;
+            while (type < MATERIAL_TEXTURE_TYPE_COUNT && textures[i].type != MATERIAL_TEXTURE_TYPES[type])
+                type++;
+            MaterialTexture texture;
+            texture.target = GL_TEXTURE_2D;
+            texture.texture = textures[i].id;
+            texture.unit = i;
+            texture.type = type;
+            texture.number = -1;
+            // textures of an unknown type, or beyond the samplers there are, are bound but nothing samples them
+            if (type < MATERIAL_TEXTURE_TYPE_COUNT && samplerCounts[type] < MATERIAL_SAMPLERS_PER_TYPE)
+                texture.number = (int)samplerCounts[type]++;
+            else
+                texture.type = 0;
+            material.textures.push_back(texture);
+        }
+        return material;
+    }
+
+    // layers of texture arrays, arrays[type] is 0 for the types the material has none of
+    static Material FromTextureArrays(const unsigned int arrays[MATERIAL_TEXTURE_TYPE_COUNT], glm::ivec4 layers)
+    {
+        Material material;
+        material.textureArrays = true;
+        material.layers = layers;
+        for (unsigned int type = 0; type < MATERIAL_TEXTURE_TYPE_COUNT; type++)
+        {
+            if (!arrays[type])
+                continue;
+            MaterialTexture texture;
+            texture.target = GL_TEXTURE_2D_ARRAY;
+            texture.texture = arrays[type];
+            texture.unit = MATERIAL_ARRAY_UNIT + type;
+            texture.type = type;
+            texture.number = -1;
+            material.textures.push_back(texture);
+        }
+        return material;
+    }
+
+    // same textures on the same units, whatever the layers: meshes with such materials can be drawn in one call
+    bool sameTextures(const Material &other) const
+    {
+        if (textureArrays != other.textureArrays || textures.size() != other.textures.size())
+            return false;
+        for (size_t i = 0; i < textures.size(); i++)
+            if (textures[i].texture != other.textures[i].texture || textures[i].unit != other.textures[i].unit ||
+                textures[i].number != other.textures[i].number || textures[i].type != other.textures[i].type)
+                return false;
+        return true;
+    }
+
+    bool operator==(const Material &other) const
+    {
+        return sameTextures(other) && layers == other.layers && shininess == other.shininess && cullFace == other.cullFace;
+    }
+
+    // binds the textures (glState drops the ones already on their units) and sets the material's uniforms
+    void bind(MaterialUniforms &uniforms, MaterialBindState &state) const
+    {
+        if (state.material == this)
+            return;
+        state.material = this;
+        // the array samplers are pointed at their units even when unused, two sampler types can't share unit 0
+        for (unsigned int type = 0; type < MATERIAL_TEXTURE_TYPE_COUNT; type++)
+            uniforms.arraySamplers[type].set(MATERIAL_ARRAY_UNIT + type);
+        for (const MaterialTexture &texture : textures)
+        {
+            if (texture.number >= 0)
+                uniforms.samplers[texture.type][texture.number].set((int)texture.unit);
+            glState.bindTexture(texture.unit, texture.target, texture.texture);
+        }
+        uniforms.textureArrays.set(textureArrays);
+        if (textureArrays)
+            uniforms.layers.set(layers);
+        uniforms.shininess.set(shininess);
+        glState.setEnabled(GL_CULL_FACE, cullFace);
+    }
+};
+
+#endif
@@ -6,134 +6,189 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <learnopengl/geometry_arena.h>
+#include <learnopengl/gl_state.h>
+#include <learnopengl/material.h>
+#include <learnopengl/mesh_data.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/vertex_format.h>
 
+#include <algorithm>
 #include <string>
 #include <vector>
 using namespace std;
 
-struct Vertex {
-    // position
-    glm::vec3 Position;
-    // normal
-    glm::vec3 Normal;
-    // texCoords
-    glm::vec2 TexCoords;
-    // tangent
-    glm::vec3 Tangent;
-    // bitangent
-    glm::vec3 Bitangent;
+// handles of the uniforms mesh draws set, resolved when the shader (or the sampler name prefix) changes instead of
+// looked up by name on every draw
+struct MeshUniforms {
+    const Shader *shader = nullptr;
+    GLuint program = 0;
+    string prefix;
+    MaterialUniforms material;
+    Uniform<glm::vec3> positionOffset;
+    Uniform<glm::vec3> positionScale;
+    Uniform<bool> instanced;
+    Uniform<bool> drawIndirect;
+
+    void resolve(const Shader &shader, const string &prefix)
+    {
+        if (this->shader == &shader && program == shader.ID && this->prefix == prefix)
+            return;
+        this->shader = &shader;
+        program = shader.ID;
+        this->prefix = prefix;
+        material.resolve(shader, prefix);
+        positionOffset = shader.uniform<glm::vec3>("meshPositionOffset");
+        positionScale = shader.uniform<glm::vec3>("meshPositionScale");
+        instanced = shader.uniform<bool>("meshInstanced");
+        drawIndirect = shader.uniform<bool>("drawIndirect");
+    }
 };
 
+// what consecutive draws have set so far, so meshes sharing a material don't set its uniforms again. vertex arrays
+// and textures that are bound already are skipped by glState
+struct MeshDrawState {
+    explicit MeshDrawState(MeshUniforms &uniforms) : uniforms(uniforms) {}
 
-
-struct Texture {
-    unsigned int id;
-    string type;
-    string path;
+    MeshUniforms &uniforms;
+    MaterialBindState material;
 };
 
+// GPU side of a mesh: the buffer objects (or the arena allocation) and textures created by MeshUploader.
+// constructing or copying a Mesh never touches OpenGL.
 class Mesh {
 public:
-    // mesh Data
-    vector<Vertex>       vertices;
-    vector<unsigned int> indices;
-    vector<Texture>      textures;
-
-    unsigned int VAO;
+    // owned by the model and shared by its meshes with the same material; null binds no textures
+    const Material *material = nullptr;
+
+    // axis aligned bounding box in model space
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+    // maps the position attribute back to model space: identity for float vertices, the bounds for quantized ones
+    glm::vec3 positionOffset = glm::vec3(0.0f);
+    glm::vec3 positionScale = glm::vec3(1.0f);
+
+    // render data. meshes uploaded into a GeometryArena use its vertex arrays and buffers instead of their own
+    GeometryArena *arena = nullptr;
+    GeometryAllocation allocation;
+    unsigned int VAO = 0;
+    unsigned int VBO = 0;
+    unsigned int EBO = 0;
+    // per instance transforms (attributes 5-8), 0 unless the mesh stands for several instances
+    unsigned int instanceVBO = 0;
+    unsigned int instanceCount = 0;
+    vector<glm::mat4> instanceTransforms;
+    unsigned int indexCount = 0;
+    // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT, see PackIndices
+    GLenum indexType = GL_UNSIGNED_INT;
+    // draw calls covering the index buffer, more than one only for large meshes with 16 bit indices
+    vector<IndexRange> indexRanges;
+    // source meshes of a merged mesh, each drawable on its own with DrawPart
+    vector<MeshPart> parts;
     std::string glslIdentifierPrefix;
-    // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
-    {
-        this->vertices = vertices;
-        this->indices = indices;
-        this->textures = textures;
 
-        // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
-    }
+    unsigned int indexSize() const { return indexType == GL_UNSIGNED_SHORT ? 2 : 4; }
 
     // render the mesh
     void Draw(Shader &shader)
     {
-        // bind appropriate textures
-        unsigned int diffuseNr  = 1;
-        unsigned int specularNr = 1;
-        unsigned int normalNr   = 1;
-        unsigned int heightNr   = 1;
-        for(unsigned int i = 0; i < textures.size(); i++)
+        MeshUniforms uniforms;
+        MeshDrawState state(uniforms);
+        Draw(shader, state);
+        state.material.restore();
+    }
+
+    // for drawing meshes in a row: sets the material only when state doesn't have it set already, and leaves the
+    // vertex array and the textures bound
+    void Draw(Shader &shader, MeshDrawState &state)
+    {
+        bindMaterial(shader, state);
+        bindGeometry();
+        drawIndices(0, indexCount, instanceCount);
+    }
+
+    // draws instances copies of the mesh in one call (one per index range), each placed by a transform the shader
+    // reads from attributes 5-8, taken from buffer starting at offset. a mesh that is instanced itself needs a
+    // transform per copy and instance of it, copy by copy, see Model::DrawInstanced
+    void DrawInstances(Shader &shader, MeshDrawState &state, GLuint buffer, size_t offset, unsigned int instances)
+    {
+        bindMaterial(shader, state);
+        state.uniforms.instanced.set(true);
+        glState.bindVertexArray(arena ? arena->vertexArray(allocation) : VAO);
+        glState.bindBuffer(GL_ARRAY_BUFFER, buffer);
+        SetInstanceAttributes(offset);
+        drawIndices(0, indexCount, instances);
+        // Draw doesn't point a vertex array of the mesh's own at its instances again
+        if (!arena && instanceVBO)
         {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-            // retrieve texture number (the N in diffuse_textureN)
-            string number;
-            string name = textures[i].type;
-            if(name == "texture_diffuse")
-                number = std::to_string(diffuseNr++);
-            else if(name == "texture_specular")
-                number = std::to_string(specularNr++); // transfer unsigned int to stream
-            else if(name == "texture_normal")
-                number = std::to_string(normalNr++); // transfer unsigned int to stream
-            else if(name == "texture_height")
-                number = std::to_string(heightNr++); // transfer unsigned int to stream
-
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (glslIdentifierPrefix + name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            glState.bindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+            SetInstanceAttributes(0);
         }
+    }
 
+    // render one of the source meshes of a merged mesh
+    void DrawPart(Shader &shader, unsigned int part)
+    {
+        MeshUniforms uniforms;
+        MeshDrawState state(uniforms);
+        bindMaterial(shader, state);
+        bindGeometry();
+        drawIndices(parts[part].firstIndex, parts[part].indexCount, instanceCount);
+        state.material.restore();
+    }
 
+    // index of the part called name, -1 when there is none
+    int findPart(const string &name) const
+    {
+        for (size_t i = 0; i < parts.size(); i++)
+            if (parts[i].name == name)
+                return (int)i;
+        return -1;
+    }
 
-        // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
-
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
+    // binds the material unless state has it bound already, and sets the per mesh uniforms
+    void bindMaterial(Shader &shader, MeshDrawState &state)
+    {
+        MeshUniforms &uniforms = state.uniforms;
+        uniforms.resolve(shader, glslIdentifierPrefix);
+        if (material)
+            material->bind(uniforms.material, state.material);
+        uniforms.positionOffset.set(positionOffset);
+        uniforms.positionScale.set(positionScale);
+        uniforms.instanced.set(instanceCount > 0);
     }
 
 private:
-    // render data
-    unsigned int VBO, EBO;
 
-    // initializes all the buffer objects/arrays
-    void setupMesh()
+    void bindGeometry()
+    {
+        glState.bindVertexArray(arena ? arena->vertexArray(allocation) : VAO);
+        if (arena && instanceCount > 0)
+            arena->bindInstances(allocation);
+    }
+
+    // draws the indices [first, first + count), split along the index ranges they overlap; instanced unless
+    // instances is 0
+    void drawIndices(unsigned int first, unsigned int count, unsigned int instances)
     {
-        // create buffers/arrays
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
-
-        glBindVertexArray(VAO);
-        // load data into vertex buffers
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        // A great thing about structs is that their memory layout is sequential for all its items.
-        // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-        // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-        // set the vertex attribute pointers
-        // vertex Positions
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-        // vertex normals
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-        // vertex texture coords
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-        // vertex tangent
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-        // vertex bitangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
-
-        glBindVertexArray(0);
+        // where the mesh starts inside the arena's shared buffers, offsets move when the arena is compacted
+        size_t indexStart = arena ? arena->indexOffset(allocation) : 0;
+        GLint vertexStart = arena ? arena->baseVertex(allocation) : 0;
+        for (const IndexRange &range : indexRanges)
+        {
+            unsigned int begin = max(first, range.firstIndex);
+            unsigned int end = min(first + count, range.firstIndex + range.indexCount);
+            if (begin >= end)
+                continue;
+            void *offset = (void*)(indexStart + (size_t)begin * indexSize());
+            GLint baseVertex = vertexStart + range.baseVertex;
+            if (instances > 0)
+                glDrawElementsInstancedBaseVertex(GL_TRIANGLES, end - begin, indexType, offset, instances, baseVertex);
+            else if (baseVertex == 0)
+                glDrawElements(GL_TRIANGLES, end - begin, indexType, offset);
+            else
+                glDrawElementsBaseVertex(GL_TRIANGLES, end - begin, indexType, offset, baseVertex);
+        }
     }
 };
 #endif
\ No newline at end of file
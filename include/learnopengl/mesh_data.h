@@ -0,0 +1,79 @@
+#ifndef MESH_DATA_H
+#define MESH_DATA_H
+
+// CPU side mesh representation. deliberately free of OpenGL so importing, caching and mesh processing
+// work on worker threads and in programs that never create a GL context.
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+using namespace std;
+
+struct Vertex {
+    // position
+    glm::vec3 Position;
+    // normal
+    glm::vec3 Normal;
+    // texCoords
+    glm::vec2 TexCoords;
+    // tangent
+    glm::vec3 Tangent;
+    // bitangent
+    glm::vec3 Bitangent;
+};
+
+// texture reference of an imported mesh before anything is uploaded: sampler type and material relative path
+struct TextureRef {
+    string type;
+    string path;
+};
+
+// one source mesh inside a mesh merged from several (see MergeMeshesByMaterial): its triangles are the
+// index range [firstIndex, firstIndex + indexCount), so it can still be told apart and drawn on its own
+struct MeshPart {
+    string name;
+    unsigned int firstIndex = 0;
+    unsigned int indexCount = 0;
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+};
+
+// CPU side result of importing one mesh; safe to build on any thread.
+// fresh imports own their geometry in the vectors, meshes read from the model cache leave them
+// empty and point into the mapped cache file instead (see ModelData::cache).
+struct MeshData {
+    vector<Vertex>       vertices;
+    vector<unsigned int> indices;
+    const Vertex       *mappedVertices = nullptr;
+    const unsigned int *mappedIndices = nullptr;
+    unsigned int mappedVertexCount = 0;
+    unsigned int mappedIndexCount = 0;
+
+    vector<TextureRef> textures;
+    string name;
+    // empty unless the mesh was merged from several
+    vector<MeshPart> parts;
+    // model space transforms the mesh is drawn with, the first one being identity; empty for a mesh drawn once as it is.
+    // see InstanceDuplicateMeshes
+    vector<glm::mat4> instances;
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+
+    const Vertex *vertexData() const { return mappedVertices ? mappedVertices : vertices.data(); }
+    const unsigned int *indexData() const { return mappedIndices ? mappedIndices : indices.data(); }
+    unsigned int vertexCount() const { return mappedVertices ? mappedVertexCount : (unsigned int)vertices.size(); }
+    unsigned int indexCount() const { return mappedIndices ? mappedIndexCount : (unsigned int)indices.size(); }
+
+    void computeBounds()
+    {
+        const Vertex *data = vertexData();
+        for (unsigned int i = 0; i < vertexCount(); i++)
+        {
+            boundsMin = i == 0 ? data[i].Position : glm::min(boundsMin, data[i].Position);
+            boundsMax = i == 0 ? data[i].Position : glm::max(boundsMax, data[i].Position);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,541 @@
+#ifndef MESH_PROCESSING_H
+#define MESH_PROCESSING_H
+
+// import time passes over freshly imported meshes. they run once per cold import on a worker thread and their
+// result is what the mesh cache stores, so none of this costs anything on a warm start.
+
+#include <learnopengl/mapped_file.h>
+#include <learnopengl/mesh_data.h>
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+struct WeldStats {
+    unsigned int verticesBefore = 0;
+    unsigned int verticesAfter = 0;
+};
+
+// post-transform cache efficiency of an index buffer, simulated with a FIFO cache.
+// ACMR: vertex shader runs per triangle (0.5 is ideal for large grids, 3 is no reuse at all).
+// ATVR: vertex shader runs per vertex (1 is ideal).
+struct VertexCacheStats {
+    float acmr = 0.0f;
+    float atvr = 0.0f;
+};
+
+// the FIFO size used for analysis and for Tipsify; small enough to hold on every GPU since the GeForce 3
+const unsigned int VERTEX_CACHE_SIZE = 16;
+
+WeldStats WeldVertices(MeshData &mesh);
+VertexCacheStats AnalyzeVertexCache(const vector<unsigned int> &indices, unsigned int vertexCount, unsigned int cacheSize = VERTEX_CACHE_SIZE);
+void OptimizeVertexCache(vector<unsigned int> &indices, unsigned int vertexCount, unsigned int cacheSize = VERTEX_CACHE_SIZE);
+void OptimizeOverdraw(vector<unsigned int> &indices, const vector<Vertex> &vertices, float threshold = 1.05f);
+void OptimizeVertexFetch(MeshData &mesh);
+void MergeMeshesByMaterial(vector<MeshData> &meshes);
+unsigned int InstanceDuplicateMeshes(vector<MeshData> &meshes, float tolerance = 1e-4f);
+bool SameTextures(const MeshData &a, const MeshData &b);
+bool FindRigidTransform(const MeshData &from, const MeshData &to, float tolerance, glm::mat4 &transform);
+
+// merges bitwise identical vertices and remaps the indices onto the unique ones. Assimp hands out one vertex per face
+// corner for OBJ files, so without this every corner is a separate vertex and the post-transform cache never hits.
+// the whole 56 byte vertex is compared, vertices that differ in any attribute (a UV seam, a hard edge) stay separate.
+WeldStats WeldVertices(MeshData &mesh)
+{
+    WeldStats stats;
+    vector<Vertex> &vertices = mesh.vertices;
+    stats.verticesBefore = stats.verticesAfter = (unsigned int)vertices.size();
+    if (vertices.empty())
+        return stats;
+
+    // open addressing table of indices into unique, at most half full
+    size_t tableSize = 1;
+    while (tableSize < vertices.size() * 2)
+        tableSize <<= 1;
+    vector<unsigned int> table(tableSize, UINT_MAX);
+    vector<unsigned int> remap(vertices.size());
+    vector<Vertex> unique;
+    unique.reserve(vertices.size());
+
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        Vertex vertex = vertices[i];
+        // -0 and +0 compare equal but hash differently
+        float *components = reinterpret_cast<float *>(&vertex);
+        for (size_t c = 0; c < sizeof(Vertex) / sizeof(float); c++)
+            if (components[c] == 0.0f)
+                components[c] = 0.0f;
+
+        size_t slot = HashBytes(&vertex, sizeof(Vertex)) & (tableSize - 1);
+        while (table[slot] != UINT_MAX && memcmp(&unique[table[slot]], &vertex, sizeof(Vertex)) != 0)
+            slot = (slot + 1) & (tableSize - 1);
+        if (table[slot] == UINT_MAX)
+        {
+            table[slot] = (unsigned int)unique.size();
+            unique.push_back(vertex);
+        }
+        remap[i] = table[slot];
+    }
+
+    for (unsigned int &index : mesh.indices)
+        index = remap[index];
+    vertices.swap(unique);
+    vertices.shrink_to_fit();
+    stats.verticesAfter = (unsigned int)vertices.size();
+    return stats;
+}
+
+VertexCacheStats AnalyzeVertexCache(const vector<unsigned int> &indices, unsigned int vertexCount, unsigned int cacheSize)
+{
+    VertexCacheStats stats;
+    // no whole triangle, nothing to average over
+    if (indices.size() < 3 || vertexCount == 0)
+        return stats;
+    // a vertex is in the FIFO while fewer than cacheSize misses happened since it was loaded
+    vector<unsigned int> loadedAt(vertexCount, 0);
+    unsigned int misses = 0;
+    for (unsigned int index : indices)
+    {
+        if (loadedAt[index] == 0 || misses - (loadedAt[index] - 1) >= cacheSize)
+        {
+            misses++;
+            loadedAt[index] = misses;
+        }
+    }
+    stats.acmr = (float)misses / (indices.size() / 3);
+    stats.atvr = (float)misses / vertexCount;
+    return stats;
+}
+
+// Tipsify (Sander, Nehab, Barczak: "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw", 2007).
+// emits all remaining triangles around a fanning vertex, then moves on to the neighbour that is still in the cache
+// and has the fewest triangles left; linear time, within a few percent of the slower Forsyth style optimizers.
+void OptimizeVertexCache(vector<unsigned int> &indices, unsigned int vertexCount, unsigned int cacheSize)
+{
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return;
+
+    // vertex -> triangles adjacency, packed
+    vector<unsigned int> liveTriangles(vertexCount, 0);
+    for (unsigned int index : indices)
+        liveTriangles[index]++;
+    vector<unsigned int> offsets(vertexCount + 1, 0);
+    for (unsigned int v = 0; v < vertexCount; v++)
+        offsets[v + 1] = offsets[v] + liveTriangles[v];
+    vector<unsigned int> adjacency(indices.size());
+    vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++)
+        adjacency[fill[indices[i]]++] = (unsigned int)(i / 3);
+
+    vector<unsigned int> cacheTime(vertexCount, 0);
+    vector<bool> emitted(triangleCount, false);
+    vector<unsigned int> deadEnds;
+    vector<unsigned int> candidates;
+    vector<unsigned int> output;
+    output.reserve(indices.size());
+    unsigned int time = cacheSize + 1;
+    unsigned int cursor = 0;
+
+    int fanning = 0;
+    while (fanning >= 0)
+    {
+        candidates.clear();
+        for (unsigned int a = offsets[fanning]; a < offsets[fanning + 1]; a++)
+        {
+            unsigned int triangle = adjacency[a];
+            if (emitted[triangle])
+                continue;
+            for (int corner = 0; corner < 3; corner++)
+            {
+                unsigned int v = indices[triangle * 3 + corner];
+                output.push_back(v);
+                deadEnds.push_back(v);
+                candidates.push_back(v);
+                liveTriangles[v]--;
+                if (time - cacheTime[v] > cacheSize)
+                    cacheTime[v] = time++;
+            }
+            emitted[triangle] = true;
+        }
+
+        // next fanning vertex: the candidate that stays in the cache longest once its remaining triangles are emitted
+        fanning = -1;
+        int bestPriority = -1;
+        for (unsigned int v : candidates)
+        {
+            if (liveTriangles[v] == 0)
+                continue;
+            int priority = 0;
+            if (time - cacheTime[v] + 2 * liveTriangles[v] <= cacheSize)
+                priority = (int)(time - cacheTime[v]);
+            if (priority > bestPriority)
+            {
+                bestPriority = priority;
+                fanning = (int)v;
+            }
+        }
+        // dead end: go back to a recently used vertex, or to the next one in index order
+        while (fanning < 0 && !deadEnds.empty())
+        {
+            unsigned int v = deadEnds.back();
+            deadEnds.pop_back();
+            if (liveTriangles[v] > 0)
+                fanning = (int)v;
+        }
+        while (fanning < 0 && cursor < vertexCount)
+        {
+            if (liveTriangles[cursor] > 0)
+                fanning = (int)cursor;
+            cursor++;
+        }
+    }
+    // meshes exported in a good order already (long strips, grids) can come out slightly worse, keep those as they are
+    if (AnalyzeVertexCache(output, vertexCount, cacheSize).acmr < AnalyzeVertexCache(indices, vertexCount, cacheSize).acmr)
+        indices.swap(output);
+}
+
+// reorders the clusters of a cache optimized index buffer so the ones facing outwards are drawn first, which lets
+// early depth testing reject more of what is behind them, from any viewpoint. clusters start where the cache is cold
+// anyway (all three vertices of a triangle miss); those are split further wherever the cluster so far, starting with
+// a cold cache, is within threshold of the whole cluster's ACMR, so reordering costs at most that much.
+void OptimizeOverdraw(vector<unsigned int> &indices, const vector<Vertex> &vertices, float threshold)
+{
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount < 2)
+        return;
+
+    // FIFO simulation that can be flushed: a vertex is cached while fewer than VERTEX_CACHE_SIZE misses happened since
+    // it was loaded and it was loaded after the last flush
+    vector<unsigned int> loadedAt(vertices.size(), 0);
+    unsigned int misses = 0, flushedAt = 0;
+    auto triangleMisses = [&](size_t t) {
+        unsigned int before = misses;
+        for (int corner = 0; corner < 3; corner++)
+        {
+            unsigned int v = indices[t * 3 + corner];
+            if (loadedAt[v] <= flushedAt || misses - (loadedAt[v] - 1) >= VERTEX_CACHE_SIZE)
+                loadedAt[v] = ++misses;
+        }
+        return misses - before;
+    };
+
+    vector<size_t> hardClusters;
+    for (size_t t = 0; t < triangleCount; t++)
+        if (triangleMisses(t) == 3)
+            hardClusters.push_back(t);
+    hardClusters.push_back(triangleCount);
+
+    vector<size_t> clusters;
+    for (size_t c = 0; c + 1 < hardClusters.size(); c++)
+    {
+        size_t begin = hardClusters[c], end = hardClusters[c + 1];
+        flushedAt = misses;
+        unsigned int clusterMisses = 0;
+        for (size_t t = begin; t < end; t++)
+            clusterMisses += triangleMisses(t);
+        float limit = (float)clusterMisses / (end - begin) * threshold;
+
+        clusters.push_back(begin);
+        flushedAt = misses;
+        unsigned int runningMisses = 0;
+        for (size_t t = begin; t < end; t++)
+        {
+            runningMisses += triangleMisses(t);
+            if (t + 1 < end && runningMisses <= limit * (t + 1 - clusters.back()))
+            {
+                clusters.push_back(t + 1);
+                flushedAt = misses;
+                runningMisses = 0;
+            }
+        }
+    }
+    clusters.push_back(triangleCount);
+
+    // sort key: how far the cluster's surface faces away from the mesh centre
+    glm::vec3 meshCentre(0.0f);
+    for (size_t i = 0; i < indices.size(); i++)
+        meshCentre += vertices[indices[i]].Position;
+    meshCentre /= (float)indices.size();
+
+    size_t clusterCount = clusters.size() - 1;
+    vector<float> keys(clusterCount);
+    for (size_t c = 0; c < clusterCount; c++)
+    {
+        glm::vec3 centre(0.0f), normal(0.0f);
+        float area = 0.0f;
+        for (size_t t = clusters[c]; t < clusters[c + 1]; t++)
+        {
+            const glm::vec3 &a = vertices[indices[t * 3]].Position;
+            const glm::vec3 &b = vertices[indices[t * 3 + 1]].Position;
+            const glm::vec3 &p = vertices[indices[t * 3 + 2]].Position;
+            // area weighted, the cross product's length is twice the triangle area
+            glm::vec3 weighted = glm::cross(b - a, p - a);
+            float weight = glm::length(weighted);
+            centre += (a + b + p) * (weight / 3.0f);
+            normal += weighted;
+            area += weight;
+        }
+        float normalLength = glm::length(normal);
+        if (area > 0.0f && normalLength > 0.0f)
+            keys[c] = glm::dot(centre / area - meshCentre, normal / normalLength);
+        else
+            keys[c] = 0.0f;
+    }
+
+    vector<size_t> order(clusterCount);
+    for (size_t c = 0; c < clusterCount; c++)
+        order[c] = c;
+    stable_sort(order.begin(), order.end(), [&keys](size_t a, size_t b) { return keys[a] > keys[b]; });
+
+    vector<unsigned int> output;
+    output.reserve(indices.size());
+    for (size_t c : order)
+        output.insert(output.end(), indices.begin() + clusters[c] * 3, indices.begin() + clusters[c + 1] * 3);
+    indices.swap(output);
+}
+
+// renumbers the vertices in the order the index buffer first uses them, so vertex fetches walk the buffer forwards
+// instead of jumping around; vertices no triangle uses are dropped
+void OptimizeVertexFetch(MeshData &mesh)
+{
+    vector<unsigned int> remap(mesh.vertices.size(), UINT_MAX);
+    vector<Vertex> ordered;
+    ordered.reserve(mesh.vertices.size());
+    for (unsigned int &index : mesh.indices)
+    {
+        if (remap[index] == UINT_MAX)
+        {
+            remap[index] = (unsigned int)ordered.size();
+            ordered.push_back(mesh.vertices[index]);
+        }
+        index = remap[index];
+    }
+    mesh.vertices.swap(ordered);
+}
+
+// merges meshes with the same material (the same texture references) into one mesh each, so a model whose submeshes
+// mostly share a handful of materials draws with a handful of calls. the merged meshes keep every source mesh as a
+// MeshPart. runs after the per mesh passes: each part keeps its optimized triangle order and its vertices stay
+// contiguous, which keeps 16 bit index ranges (see PackIndices) long.
+// meshes drawn with instances (see InstanceDuplicateMeshes) are left alone, their transforms cover the whole mesh.
+void MergeMeshesByMaterial(vector<MeshData> &meshes)
+{
+    vector<MeshData> merged;
+    for (MeshData &mesh : meshes)
+    {
+        if (!mesh.instances.empty())
+        {
+            merged.push_back(std::move(mesh));
+            continue;
+        }
+        MeshData *target = nullptr;
+        for (MeshData &candidate : merged)
+            if (candidate.instances.empty() && SameTextures(candidate, mesh))
+                target = &candidate;
+        if (!target)
+        {
+            merged.push_back(MeshData());
+            target = &merged.back();
+            target->textures = mesh.textures;
+            target->name = mesh.name;
+            target->boundsMin = mesh.boundsMin;
+            target->boundsMax = mesh.boundsMax;
+        }
+
+        MeshPart part;
+        part.name = mesh.name;
+        part.firstIndex = (unsigned int)target->indices.size();
+        part.indexCount = mesh.indexCount();
+        part.boundsMin = mesh.boundsMin;
+        part.boundsMax = mesh.boundsMax;
+        target->parts.push_back(part);
+
+        unsigned int firstVertex = (unsigned int)target->vertices.size();
+        target->vertices.insert(target->vertices.end(), mesh.vertexData(), mesh.vertexData() + mesh.vertexCount());
+        const unsigned int *indices = mesh.indexData();
+        for (unsigned int i = 0; i < mesh.indexCount(); i++)
+            target->indices.push_back(firstVertex + indices[i]);
+        target->boundsMin = glm::min(target->boundsMin, mesh.boundsMin);
+        target->boundsMax = glm::max(target->boundsMax, mesh.boundsMax);
+    }
+    meshes = std::move(merged);
+}
+
+// finds meshes that repeat the geometry of an earlier mesh at another position or orientation (chess pieces, say) and
+// turns them into instances of it: the earlier mesh becomes the prototype and records one transform per occurrence,
+// the repeats are removed. runs before the per mesh passes, so those only process the prototypes.
+// candidates are bucketed by topology (index buffer, vertex count, material); within a bucket the centred geometry is
+// compared, see FindRigidTransform. tolerance is relative to the size of the mesh. returns how many meshes were removed.
+unsigned int InstanceDuplicateMeshes(vector<MeshData> &meshes, float tolerance)
+{
+    unordered_map<uint64_t, vector<size_t>> prototypes;
+    vector<bool> duplicate(meshes.size(), false);
+    unsigned int removed = 0;
+    for (size_t i = 0; i < meshes.size(); i++)
+    {
+        const MeshData &mesh = meshes[i];
+        unsigned int counts[2] = {mesh.vertexCount(), mesh.indexCount()};
+        uint64_t key = HashBytes(counts, sizeof(counts));
+        key = HashBytes(mesh.indexData(), (size_t)mesh.indexCount() * sizeof(unsigned int), key);
+        for (const TextureRef &texture : mesh.textures)
+        {
+            key = HashBytes(texture.type.data(), texture.type.size(), key);
+            key = HashBytes(texture.path.data(), texture.path.size(), key);
+        }
+
+        vector<size_t> &candidates = prototypes[key];
+        for (size_t p : candidates)
+        {
+            MeshData &prototype = meshes[p];
+            glm::mat4 transform;
+            if (prototype.indexCount() != mesh.indexCount() || prototype.vertexCount() != mesh.vertexCount() ||
+                !SameTextures(prototype, mesh) ||
+                memcmp(prototype.indexData(), mesh.indexData(), (size_t)mesh.indexCount() * sizeof(unsigned int)) != 0 ||
+                !FindRigidTransform(prototype, mesh, tolerance, transform))
+                continue;
+            if (prototype.instances.empty())
+                prototype.instances.push_back(glm::mat4(1.0f));
+            prototype.instances.push_back(transform);
+            duplicate[i] = true;
+            removed++;
+            break;
+        }
+        if (!duplicate[i])
+            candidates.push_back(i);
+    }
+    if (removed == 0)
+        return 0;
+
+    vector<MeshData> kept;
+    for (size_t i = 0; i < meshes.size(); i++)
+        if (!duplicate[i])
+            kept.push_back(std::move(meshes[i]));
+    meshes = std::move(kept);
+    return removed;
+}
+
+bool SameTextures(const MeshData &a, const MeshData &b)
+{
+    if (a.textures.size() != b.textures.size())
+        return false;
+    for (size_t i = 0; i < a.textures.size(); i++)
+        if (a.textures[i].type != b.textures[i].type || a.textures[i].path != b.textures[i].path)
+            return false;
+    return true;
+}
+
+// looks for a rotation + translation moving every vertex of from onto the vertex with the same index in to.
+// both meshes are centred on their centroids first. PCA axes would be the textbook orientation normalisation, but they
+// are ambiguous for the rotationally symmetric shapes duplicates tend to be, so the rotation is solved directly instead:
+// the least squares linear map between the centred positions, accepted only if it is orthonormal without a mirror and
+// maps positions, normals and tangents within tolerance. flat meshes (no unique solution) are only matched up to
+// translation.
+bool FindRigidTransform(const MeshData &from, const MeshData &to, float tolerance, glm::mat4 &transform)
+{
+    const Vertex *a = from.vertexData();
+    const Vertex *b = to.vertexData();
+    unsigned int count = from.vertexCount();
+    if (count == 0 || count != to.vertexCount())
+        return false;
+
+    double centreA[3] = {0, 0, 0}, centreB[3] = {0, 0, 0};
+    for (unsigned int v = 0; v < count; v++)
+        for (int k = 0; k < 3; k++)
+        {
+            centreA[k] += a[v].Position[k] / count;
+            centreB[k] += b[v].Position[k] / count;
+        }
+    // covariance of from, and the cross covariance of to against from
+    double covariance[3][3] = {}, cross[3][3] = {};
+    double traceB = 0.0;
+    for (unsigned int v = 0; v < count; v++)
+    {
+        double pa[3], pb[3];
+        for (int k = 0; k < 3; k++)
+        {
+            pa[k] = a[v].Position[k] - centreA[k];
+            pb[k] = b[v].Position[k] - centreB[k];
+            traceB += pb[k] * pb[k];
+        }
+        for (int r = 0; r < 3; r++)
+            for (int c = 0; c < 3; c++)
+            {
+                covariance[r][c] += pa[r] * pa[c];
+                cross[r][c] += pb[r] * pa[c];
+            }
+    }
+    // the spread around the centroid is rotation invariant, a cheap way out for most non matches
+    double traceA = covariance[0][0] + covariance[1][1] + covariance[2][2];
+    if (fabs(traceA - traceB) > 1e-3 * max(traceA, 1e-12))
+        return false;
+
+    double rotation[3][3] = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}};
+    double determinant = covariance[0][0] * (covariance[1][1] * covariance[2][2] - covariance[1][2] * covariance[2][1]) -
+                         covariance[0][1] * (covariance[1][0] * covariance[2][2] - covariance[1][2] * covariance[2][0]) +
+                         covariance[0][2] * (covariance[1][0] * covariance[2][1] - covariance[1][1] * covariance[2][0]);
+    if (fabs(determinant) > 1e-9 * traceA * traceA * traceA)
+    {
+        // rotation = cross * covariance^-1
+        double inverse[3][3];
+        for (int r = 0; r < 3; r++)
+            for (int c = 0; c < 3; c++)
+            {
+                int r1 = (c + 1) % 3, r2 = (c + 2) % 3, c1 = (r + 1) % 3, c2 = (r + 2) % 3;
+                inverse[r][c] = (covariance[r1][c1] * covariance[r2][c2] - covariance[r1][c2] * covariance[r2][c1]) / determinant;
+            }
+        for (int r = 0; r < 3; r++)
+            for (int c = 0; c < 3; c++)
+                rotation[r][c] = cross[r][0] * inverse[0][c] + cross[r][1] * inverse[1][c] + cross[r][2] * inverse[2][c];
+        for (int i = 0; i < 3; i++)
+            for (int j = 0; j < 3; j++)
+            {
+                double dot = rotation[0][i] * rotation[0][j] + rotation[1][i] * rotation[1][j] + rotation[2][i] * rotation[2][j];
+                if (fabs(dot - (i == j ? 1.0 : 0.0)) > 1e-3)
+                    return false;
+            }
+        double handedness = rotation[0][0] * (rotation[1][1] * rotation[2][2] - rotation[1][2] * rotation[2][1]) -
+                            rotation[0][1] * (rotation[1][0] * rotation[2][2] - rotation[1][2] * rotation[2][0]) +
+                            rotation[0][2] * (rotation[1][0] * rotation[2][1] - rotation[1][1] * rotation[2][0]);
+        if (handedness < 0.0)
+            return false;
+    }
+
+    glm::vec3 extent = from.boundsMax - from.boundsMin;
+    double limit = tolerance * max((double)glm::length(extent), 1e-6);
+    auto rotate = [&](const glm::vec3 &value, int k)
+    {
+        return rotation[k][0] * value[0] + rotation[k][1] * value[1] + rotation[k][2] * value[2];
+    };
+    double translation[3];
+    for (int k = 0; k < 3; k++)
+        translation[k] = centreB[k] - (rotation[k][0] * centreA[0] + rotation[k][1] * centreA[1] + rotation[k][2] * centreA[2]);
+    for (unsigned int v = 0; v < count; v++)
+    {
+        double distance = 0.0, normal = 0.0, tangent = 0.0;
+        for (int k = 0; k < 3; k++)
+        {
+            double p = rotate(a[v].Position, k) + translation[k];
+            distance += (p - b[v].Position[k]) * (p - b[v].Position[k]);
+            normal += (rotate(a[v].Normal, k) - b[v].Normal[k]) * (rotate(a[v].Normal, k) - b[v].Normal[k]);
+            tangent += (rotate(a[v].Tangent, k) - b[v].Tangent[k]) * (rotate(a[v].Tangent, k) - b[v].Tangent[k]);
+        }
+        if (distance > limit * limit || normal > 1e-4 || tangent > 1e-4 ||
+            fabs(a[v].TexCoords.x - b[v].TexCoords.x) > 1e-5f || fabs(a[v].TexCoords.y - b[v].TexCoords.y) > 1e-5f)
+            return false;
+    }
+
+    transform = glm::mat4(1.0f);
+    for (int c = 0; c < 3; c++)
+        for (int r = 0; r < 3; r++)
+            transform[c][r] = (float)rotation[r][c];
+    for (int r = 0; r < 3; r++)
+        transform[3][r] = (float)translation[r];
+    return true;
+}
+
+#endif
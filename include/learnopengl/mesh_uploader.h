@@ -0,0 +1,89 @@
+#ifndef MESH_UPLOADER_H
+#define MESH_UPLOADER_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/geometry_arena.h>
+#include <learnopengl/gl_state.h>
+#include <learnopengl/mesh.h>
+#include <learnopengl/mesh_data.h>
+#include <learnopengl/vertex_format.h>
+
+#include <cstddef>
+#include <vector>
+using namespace std;
+
+// turns CPU side mesh data into GPU resources. has to run on the thread owning the GL context;
+// everything before this step (import, cache, processing passes) works without one.
+class MeshUploader
+{
+public:
+    // with an arena the geometry is suballocated from its shared buffers, without one the mesh gets buffers of its own
+    static Mesh upload(const MeshData &data, const Material *material, VertexLayout layout = VertexLayout::Compact,
+                       GeometryArena *arena = nullptr)
+    {
+        Mesh mesh;
+        mesh.material = material;
+        mesh.boundsMin = data.boundsMin;
+        mesh.boundsMax = data.boundsMax;
+        mesh.indexCount = data.indexCount();
+        mesh.parts = data.parts;
+        mesh.instanceCount = (unsigned int)data.instances.size();
+        mesh.instanceTransforms = data.instances;
+
+        vector<PackedVertex> packed;
+        const void *vertices = data.vertexData();
+        size_t vertexBytes = (size_t)data.vertexCount() * sizeof(Vertex);
+        if (layout == VertexLayout::Compact)
+        {
+            packed = PackVertices(data.vertexData(), data.vertexCount(), data.boundsMin, data.boundsMax);
+            vertices = packed.data();
+            vertexBytes = packed.size() * sizeof(PackedVertex);
+            mesh.positionOffset = data.boundsMin;
+            mesh.positionScale = data.boundsMax - data.boundsMin;
+        }
+
+        PackedIndices indices = PackIndices(data.indexData(), data.indexCount(), data.vertexCount());
+        mesh.indexType = indices.indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        mesh.indexRanges = indices.ranges;
+
+        if (arena)
+        {
+            mesh.arena = arena;
+            mesh.allocation = arena->allocate(layout, vertices, vertexBytes, indices.data.data(), indices.data.size(), data.instances);
+            return mesh;
+        }
+
+        // create buffers/arrays
+        glGenVertexArrays(1, &mesh.VAO);
+        glGenBuffers(1, &mesh.VBO);
+        glGenBuffers(1, &mesh.EBO);
+
+        glState.bindVertexArray(mesh.VAO);
+        // load data into vertex buffers
+        glState.bindBuffer(GL_ARRAY_BUFFER, mesh.VBO);
+        // A great thing about structs is that their memory layout is sequential for all its items.
+        // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
+        // again translates to 3/2 floats which translates to a byte array.
+        glBufferData(GL_ARRAY_BUFFER, vertexBytes, vertices, GL_STATIC_DRAW);
+
+        glState.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.data.size(), indices.data.data(), GL_STATIC_DRAW);
+
+        // set the vertex attribute pointers
+        SetVertexAttributes(layout);
+
+        if (!data.instances.empty())
+        {
+            glGenBuffers(1, &mesh.instanceVBO);
+            glState.bindBuffer(GL_ARRAY_BUFFER, mesh.instanceVBO);
+            glBufferData(GL_ARRAY_BUFFER, data.instances.size() * sizeof(glm::mat4), &data.instances[0], GL_STATIC_DRAW);
+            SetInstanceAttributes(0);
+        }
+
+        glState.bindVertexArray(0);
+        return mesh;
+    }
+};
+
+#endif
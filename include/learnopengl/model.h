@@ -6,45 +6,77 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <stb_image.h>
-#include <assimp/Importer.hpp>
-#include <assimp/scene.h>
-#include <assimp/postprocess.h>
 
+#include <learnopengl/geometry_arena.h>
+#include <learnopengl/gl_ext.h>
+#include <learnopengl/gl_state.h>
 #include <learnopengl/mesh.h>
+#include <learnopengl/mesh_uploader.h>
+#include <learnopengl/model_importer.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/image.h>
+#include <learnopengl/texture_cache.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
 #include <string>
+#include <unordered_map>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <vector>
 using namespace std;
 
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
 
+unsigned int TextureFromImage(const DecodedImage &image);
 
+// per instance data of a Model::DrawIndirect draw, read through attributes 5-10 at the command's base instance.
+// the uniforms Mesh::Draw sets per mesh can't change within one multi draw, so they travel here instead.
+struct IndirectInstance {
+    glm::mat4 transform;            // the copy's transform times the mesh instance's, identity for neither
+    glm::vec4 positionOffset;       // xyz: Mesh::positionOffset
+    glm::vec4 positionScale;        // xyz: Mesh::positionScale
+    glm::ivec4 materialLayers;      // Material::layers
+};
 
 class Model
 {
 public:
     // model data
     vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
+    // the distinct materials of the meshes, built in upload()
+    vector<unique_ptr<Material>> materials;
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
+    // true when the meshes came from the binary mesh cache instead of Assimp
+    bool loadedFromCache = false;
+    // how upload() stores vertices; shaders drawing Compact meshes have to decode positions, see PackedVertex
+    VertexLayout vertexLayout = VertexLayout::Compact;
+
+    // empty model, filled in later by upload() (see ModelLoader)
+    Model() : gammaCorrection(false) {}
 
     // constructor, expects a filepath to a 3D model.
     Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
     {
-        loadModel(path);
+        ModelData data = ModelImporter::Import(path);
+        upload(data);
     }
 
-    // draws the model, and thus all its meshes
+    // draws the model, and thus all its meshes. meshes sharing a vertex array (see GeometryArena) are drawn without
+    // rebinding it
     void Draw(Shader &shader)
     {
+        MeshDrawState state(meshUniforms);
         for(unsigned int i = 0; i < meshes.size(); i++)
-            meshes[i].Draw(shader);
+            meshes[i].Draw(shader, state);
+        state.material.restore();
     }
 
     void SetShaderTextureNamePrefix(std::string prefix) {
@@ -52,167 +84,539 @@ public:
             mesh.glslIdentifierPrefix = prefix;
         }
     }
-private:
-    // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
-    void loadModel(string const &path)
+
+    // GL half of loading a model: creates the buffers and textures of imported data. must run on the thread owning the
+    // GL context. with a texture cache the textures are shared with everything else using it and are streamed in
+    // the background, packed into texture arrays where they can be (see packTextureArrays); without one they are
+    // loaded right away as 2D textures. with a geometry arena the meshes are suballocated from its shared buffers,
+    // without one every mesh gets buffers of its own.
+    void upload(ModelData &data, TextureCache *textureCache = nullptr, GeometryArena *geometry = nullptr)
+    {
+        directory = data.directory;
+        loadedFromCache = data.fromCache;
+        vector<MaterialArrayRefs> arrayRefs;
+        if (textureCache)
+            arrayRefs = packTextureArrays(data, *textureCache);
+        meshes.reserve(meshes.size() + data.meshes.size());
+        size_t vertexCount = 0, indexCount = 0, indexBytes = 0;
+        for (size_t m = 0; m < data.meshes.size(); m++)
+        {
+            const MeshData &mesh = data.meshes[m];
+            Material material;
+            if (m < arrayRefs.size() && arrayRefs[m].packed)
+            {
+                unsigned int arrays[MATERIAL_TEXTURE_TYPE_COUNT] = {};
+                glm::ivec4 layers(0);
+                for (unsigned int type = 0; type < MATERIAL_TEXTURE_TYPE_COUNT; type++)
+                {
+                    if (arrayRefs[m].array[type] < 0)
+                        continue;
+                    arrays[type] = textureArrays_loaded[arrayRefs[m].array[type]];
+                    layers[type] = arrayRefs[m].layer[type];
+                }
+                // an unset specular sampler used to read unit 0, the diffuse texture, so meshes without a specular
+                // map keep taking their specular intensity from it
+                if (!arrays[1])
+                {
+                    arrays[1] = arrays[0];
+                    layers[1] = layers[0];
+                }
+                material = Material::FromTextureArrays(arrays, layers);
+            }
+            else
+            {
+                vector<Texture> textures;
+                for (const TextureRef &reference : mesh.textures)
+                    textures.push_back(loadTexture(reference.path, reference.type, textureCache));
+                material = Material::FromTextures(textures);
+            }
+            meshes.push_back(MeshUploader::upload(mesh, addMaterial(material), vertexLayout, geometry));
+            vertexCount += mesh.vertexCount();
+            indexCount += mesh.indexCount();
+            indexBytes += (size_t)meshes.back().indexCount * meshes.back().indexSize();
+        }
+        cout << "MODEL:: " << data.path << " " << materials.size() << " materials, vertex buffers " << vertexCount * VertexSize(vertexLayout) / 1024
+             << " KB (" << vertexCount * sizeof(Vertex) / 1024 << " KB as floats), index buffers " << indexBytes / 1024
+             << " KB (" << indexCount * sizeof(unsigned int) / 1024 << " KB as 32 bit)" << endl;
+    }
+
+    // draws a copy of the model per transform, each placed by its transform after the shader's model matrix: one
+    // instanced draw per mesh and index range for all copies instead of a Draw per copy. the shader has to take the
+    // transform from attributes 5-8 when meshInstanced is set, like light.vs, tree.vs and normal_mapping.vs do
+    void DrawInstanced(Shader &shader, const glm::mat4 *transforms, unsigned int count)
+    {
+        if (!count || meshes.empty())
+            return;
+        // copies that didn't move since the last call are drawn from what is in the buffer already
+        if (!copyInstances.id || !sameTransforms(copyInstancesSource, transforms, count))
+        {
+            copyInstancesSource.assign(transforms, transforms + count);
+            copyTransforms.clear();
+            copyFirst.clear();
+            for (const Mesh &mesh : meshes)
+            {
+                copyFirst.push_back(copyTransforms.size());
+                for (unsigned int copy = 0; copy < count; copy++)
+                    for (unsigned int n = 0; n < max(mesh.instanceCount, 1u); n++)
+                        copyTransforms.push_back(copyTransform(transforms[copy], mesh, n));
+            }
+            copyInstances.upload(GL_ARRAY_BUFFER, copyTransforms.data(), copyTransforms.size() * sizeof(glm::mat4));
+        }
+
+        MeshDrawState state(meshUniforms);
+        for (size_t i = 0; i < meshes.size(); i++)
+            meshes[i].DrawInstances(shader, state, copyInstances.id, copyFirst[i] * sizeof(glm::mat4),
+                                    count * max(meshes[i].instanceCount, 1u));
+        state.material.restore();
+    }
+    void DrawInstanced(Shader &shader, const vector<glm::mat4> &transforms)
+    {
+        DrawInstanced(shader, transforms.data(), (unsigned int)transforms.size());
+    }
+
+    // draws the whole model with one glMultiDrawElementsIndirect per set of texture arrays and index type instead of
+    // one call per mesh and index range. the commands are built on first use and whenever the arena moved them. needs
+    // every mesh in the same GeometryArena, multi draw indirect with base instance, and a shader that reads the per
+    // draw data from attributes (drawIndirect in light.vs); anything else falls back to Draw.
+    void DrawIndirect(Shader &shader)
     {
-        // read file via ASSIMP
-        Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
-        // check for errors
-        if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
+        if (!glExtensions.multiDrawIndirect || !buildIndirect())
         {
-            cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
+            Draw(shader);
             return;
         }
-        // retrieve the directory path of the filepath
-        directory = path.substr(0, path.find_last_of('/'));
+        drawIndirect(shader, indirectCommandBuffer, indirectInstanceBuffer);
+    }
 
-        // process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
+    // DrawInstanced with multi draw indirect: the copies are more instances of the same commands, so all of them take
+    // as many calls as one copy. commands and instance data are refilled when the transforms differ from the last
+    // call's or the arena moved the meshes; falls back to DrawInstanced
+    void DrawIndirect(Shader &shader, const glm::mat4 *transforms, unsigned int count)
+    {
+        if (!count)
+            return;
+        if (!glExtensions.multiDrawIndirect || !buildIndirect())
+        {
+            DrawInstanced(shader, transforms, count);
+            return;
+        }
+        if (!copyCommandBuffer.id || copyIndirectGeneration != indirectGeneration ||
+            !sameTransforms(copyIndirectSource, transforms, count))
+        {
+            copyIndirectSource.assign(transforms, transforms + count);
+            copyIndirectGeneration = indirectGeneration;
+            fillIndirect(transforms, count, copyCommands, copyIndirectInstances);
+            copyCommandBuffer.upload(GL_DRAW_INDIRECT_BUFFER, copyCommands.data(),
+                                     copyCommands.size() * sizeof(DrawElementsIndirectCommand));
+            copyIndirectBuffer.upload(GL_ARRAY_BUFFER, copyIndirectInstances.data(),
+                                      copyIndirectInstances.size() * sizeof(IndirectInstance));
+        }
+        drawIndirect(shader, copyCommandBuffer.id, copyIndirectBuffer.id);
+    }
+    void DrawIndirect(Shader &shader, const vector<glm::mat4> &transforms)
+    {
+        DrawIndirect(shader, transforms.data(), (unsigned int)transforms.size());
     }
 
-    // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode *node, const aiScene *scene)
+    // gives the model's geometry back to the arena it was uploaded into; the meshes can't be drawn afterwards
+    void releaseGeometry(GeometryArena &geometry)
     {
-        // process each mesh located at the current node
-        for(unsigned int i = 0; i < node->mNumMeshes; i++)
+        for (Mesh &mesh : meshes)
+            if (mesh.arena == &geometry)
+                geometry.free(mesh.allocation);
+        meshes.clear();
+        if (indirectCommandBuffer)
         {
-            // the node object only contains indices to index the actual objects in the scene.
-            // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
-            aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
+            glState.deleteBuffers(1, &indirectCommandBuffer);
+            glState.deleteBuffers(1, &indirectInstanceBuffer);
+            indirectCommandBuffer = indirectInstanceBuffer = 0;
         }
-        // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
-        for(unsigned int i = 0; i < node->mNumChildren; i++)
+        indirectBatches.clear();
+        indirectOrder.clear();
+        copyInstances.release();
+        copyCommandBuffer.release();
+        copyIndirectBuffer.release();
+    }
+
+    // gives the model's references to its textures back to the cache they came from
+    void releaseTextures(TextureCache &textureCache)
+    {
+        for (const Texture &texture : textures_loaded)
+            textureCache.release(texture.id);
+        for (unsigned int textureArray : textureArrays_loaded)
+            textureCache.release(textureArray);
+        textures_loaded.clear();
+        textureArrays_loaded.clear();
+        loadedTextureIndex.clear();
+    }
+private:
+    // path of a material texture -> its position in textures_loaded
+    unordered_map<string, size_t> loadedTextureIndex;
+    // texture arrays holding the material textures of the materials with Material::textureArrays
+    vector<unsigned int> textureArrays_loaded;
+    // uniform handles of the shader the model was last drawn with
+    MeshUniforms meshUniforms;
+
+    // where the material textures of an imported mesh ended up: per MATERIAL_TEXTURE_TYPES entry an index into
+    // textureArrays_loaded (-1 for none) and the layer. meshes that aren't packed keep their 2D textures.
+    struct MaterialArrayRefs {
+        bool packed = false;
+        int array[MATERIAL_TEXTURE_TYPE_COUNT] = {-1, -1, -1, -1};
+        int layer[MATERIAL_TEXTURE_TYPE_COUNT] = {};
+    };
+
+    // consecutive commands drawn with one glMultiDrawElementsIndirect, all with the material of meshes[mesh]
+    struct IndirectBatch {
+        GLenum indexType;
+        size_t mesh;
+        size_t firstCommand;
+        GLsizei commandCount;
+    };
+    vector<IndirectBatch> indirectBatches;
+    // meshes in the order of their commands
+    vector<size_t> indirectOrder;
+    GLuint indirectCommandBuffer = 0;
+    GLuint indirectInstanceBuffer = 0;
+    unsigned int indirectGeneration = 0;
+
+    // buffer refilled whenever what is drawn from it changes. the storage is orphaned rather than waited on while the
+    // GPU still reads the last contents, and keeps the largest size it had so the driver can hand the same block back
+    struct StreamBuffer {
+        GLuint id = 0;
+        size_t capacity = 0;
+
+        void upload(GLenum target, const void *data, size_t size)
         {
-            processNode(node->mChildren[i], scene);
+            if (!id)
+                glGenBuffers(1, &id);
+            glState.bindBuffer(target, id);
+            capacity = max(capacity, size);
+            glBufferData(target, capacity, nullptr, GL_STREAM_DRAW);
+            glBufferSubData(target, 0, size, data);
         }
 
+        void release()
+        {
+            if (id)
+                glState.deleteBuffers(1, &id);
+            id = 0;
+            capacity = 0;
+        }
+    };
+    // per copy data of DrawInstanced and DrawIndirect with transforms, kept to not allocate on every draw. the
+    // sources are the transforms the buffers were last filled for
+    StreamBuffer copyInstances;
+    StreamBuffer copyCommandBuffer;
+    StreamBuffer copyIndirectBuffer;
+    vector<glm::mat4> copyInstancesSource;
+    vector<glm::mat4> copyIndirectSource;
+    unsigned int copyIndirectGeneration = 0;
+    vector<glm::mat4> copyTransforms;
+    vector<size_t> copyFirst;
+    vector<DrawElementsIndirectCommand> copyCommands;
+    vector<IndirectInstance> copyIndirectInstances;
+
+    static bool sameTransforms(const vector<glm::mat4> &source, const glm::mat4 *transforms, unsigned int count)
+    {
+        return source.size() == count && memcmp(source.data(), transforms, count * sizeof(glm::mat4)) == 0;
     }
 
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+    // transform of instance n of mesh in the copy placed by copy
+    static glm::mat4 copyTransform(const glm::mat4 &copy, const Mesh &mesh, unsigned int n)
     {
-        // data to fill
-        vector<Vertex> vertices;
-        vector<unsigned int> indices;
-        vector<Texture> textures;
+        return mesh.instanceCount ? copy * mesh.instanceTransforms[n] : copy;
+    }
 
-        // walk through each of the mesh's vertices
-        for(unsigned int i = 0; i < mesh->mNumVertices; i++)
+    // the indirect draws of buildIndirect's batches, with the commands and per instance data in the buffers given
+    void drawIndirect(Shader &shader, GLuint commandBuffer, GLuint instanceBuffer)
+    {
+        glState.bindVertexArray(meshes[0].arena->vertexArray(meshes[0].allocation));
+        glState.bindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        for (unsigned int column = 0; column < 4; column++)
         {
-            Vertex vertex;
-            glm::vec3 vector; // we declare a placeholder vector since assimp_ uses its own vector class that doesn't directly convert to glm's vec3 class so we transfer the data to this placeholder glm::vec3 first.
-            // positions
-            vector.x = mesh->mVertices[i].x;
-            vector.y = mesh->mVertices[i].y;
-            vector.z = mesh->mVertices[i].z;
-            vertex.Position = vector;
-            // normals
-            if (mesh->HasNormals())
+            glEnableVertexAttribArray(5 + column);
+            glVertexAttribPointer(5 + column, 4, GL_FLOAT, GL_FALSE, sizeof(IndirectInstance),
+                                  (void*)(offsetof(IndirectInstance, transform) + column * sizeof(glm::vec4)));
+            glVertexAttribDivisor(5 + column, 1);
+        }
+        glEnableVertexAttribArray(9);
+        glVertexAttribPointer(9, 4, GL_FLOAT, GL_FALSE, sizeof(IndirectInstance), (void*)offsetof(IndirectInstance, positionOffset));
+        glVertexAttribDivisor(9, 1);
+        glEnableVertexAttribArray(10);
+        glVertexAttribPointer(10, 4, GL_FLOAT, GL_FALSE, sizeof(IndirectInstance), (void*)offsetof(IndirectInstance, positionScale));
+        glVertexAttribDivisor(10, 1);
+        glEnableVertexAttribArray(11);
+        glVertexAttribIPointer(11, 4, GL_INT, sizeof(IndirectInstance), (void*)offsetof(IndirectInstance, materialLayers));
+        glVertexAttribDivisor(11, 1);
+
+        meshUniforms.resolve(shader, meshes[0].glslIdentifierPrefix);
+        meshUniforms.drawIndirect.set(true);
+        glState.bindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+        MeshDrawState state(meshUniforms);
+        for (const IndirectBatch &batch : indirectBatches)
+        {
+            meshes[batch.mesh].bindMaterial(shader, state);
+            glExtensions.multiDrawElementsIndirect(GL_TRIANGLES, batch.indexType,
+                                                   (void*)(batch.firstCommand * sizeof(DrawElementsIndirectCommand)),
+                                                   batch.commandCount, 0);
+        }
+        meshUniforms.drawIndirect.set(false);
+
+        // the arena's vertex array is shared with Mesh::Draw, which doesn't know about these
+        glDisableVertexAttribArray(9);
+        glDisableVertexAttribArray(10);
+        glDisableVertexAttribArray(11);
+        state.material.restore();
+    }
+
+    // commands and per instance data of the meshes in indirectOrder for count copies placed by transforms, or for
+    // the model as it is without transforms. the copies of a mesh are instances of its commands, so the commands
+    // line up with indirectBatches however many copies there are
+    void fillIndirect(const glm::mat4 *transforms, unsigned int count, vector<DrawElementsIndirectCommand> &commands,
+                      vector<IndirectInstance> &instances) const
+    {
+        GeometryArena *arena = meshes[0].arena;
+        commands.clear();
+        instances.clear();
+        for (size_t i : indirectOrder)
+        {
+            const Mesh &mesh = meshes[i];
+            GLuint baseInstance = (GLuint)instances.size();
+            unsigned int instanceCount = max(mesh.instanceCount, 1u);
+            for (unsigned int copy = 0; copy < count; copy++)
             {
-                vector.x = mesh->mNormals[i].x;
-                vector.y = mesh->mNormals[i].y;
-                vector.z = mesh->mNormals[i].z;
-                vertex.Normal = vector;
+                for (unsigned int n = 0; n < instanceCount; n++)
+                {
+                    IndirectInstance instance;
+                    instance.transform = copyTransform(transforms ? transforms[copy] : glm::mat4(1.0f), mesh, n);
+                    instance.positionOffset = glm::vec4(mesh.positionOffset, 0.0f);
+                    instance.positionScale = glm::vec4(mesh.positionScale, 0.0f);
+                    instance.materialLayers = mesh.material ? mesh.material->layers : glm::ivec4(0);
+                    instances.push_back(instance);
+                }
             }
-            // texture coordinates
-            if(mesh->mTextureCoords[0]) // does the mesh contain texture coordinates?
+            // ranges of one mesh share its instances
+            GLuint firstIndex = (GLuint)(arena->indexOffset(mesh.allocation) / mesh.indexSize());
+            for (const IndexRange &range : mesh.indexRanges)
             {
-                glm::vec2 vec;
-                // a vertex can contain up to 8 different texture coordinates. We thus make the assumption that we won't
-                // use models where a vertex can have multiple texture coordinates so we always take the first set (0).
-                vec.x = mesh->mTextureCoords[0][i].x;
-                vec.y = mesh->mTextureCoords[0][i].y;
-                vertex.TexCoords = vec;
-                // tangent
-                vector.x = mesh->mTangents[i].x;
-                vector.y = mesh->mTangents[i].y;
-                vector.z = mesh->mTangents[i].z;
-                vertex.Tangent = vector;
-                // bitangent
-                vector.x = mesh->mBitangents[i].x;
-                vector.y = mesh->mBitangents[i].y;
-                vector.z = mesh->mBitangents[i].z;
-                vertex.Bitangent = vector;
+                DrawElementsIndirectCommand command;
+                command.count = range.indexCount;
+                command.instanceCount = count * instanceCount;
+                command.firstIndex = firstIndex + range.firstIndex;
+                command.baseVertex = arena->baseVertex(mesh.allocation) + range.baseVertex;
+                command.baseInstance = baseInstance;
+                commands.push_back(command);
             }
-            else
-                vertex.TexCoords = glm::vec2(0.0f, 0.0f);
-
-            vertices.push_back(vertex);
+        }
+    }
 
+    // (re)builds the indirect commands when there are none or the arena compacted since; false if the model can't be
+    // drawn indirectly
+    bool buildIndirect()
+    {
+        if (meshes.empty())
+            return false;
+        GeometryArena *arena = meshes[0].arena;
+        for (const Mesh &mesh : meshes)
+            if (!mesh.arena || mesh.arena != arena || mesh.allocation.layout != meshes[0].allocation.layout)
+                return false;
+        if (!indirectBatches.empty() && indirectGeneration == arena->layoutGeneration())
+            return true;
+
+        // one batch per set of texture arrays (or 2D textures) and index type, in order of first appearance
+        vector<vector<size_t>> groups;
+        for (size_t i = 0; i < meshes.size(); i++)
+        {
+            size_t group = 0;
+            for (; group < groups.size(); group++)
+            {
+                const Mesh &first = meshes[groups[group][0]];
+                if (first.indexType == meshes[i].indexType && sameMaterial(first, meshes[i]))
+                    break;
+            }
+            if (group == groups.size())
+                groups.push_back(vector<size_t>());
+            groups[group].push_back(i);
+        }
 
+        indirectBatches.clear();
+        indirectOrder.clear();
+        size_t commandCount = 0;
+        for (size_t group = 0; group < groups.size(); group++)
+        {
+            IndirectBatch batch;
+            batch.indexType = meshes[groups[group][0]].indexType;
+            batch.mesh = groups[group][0];
+            batch.firstCommand = commandCount;
+            for (size_t i : groups[group])
+            {
+                indirectOrder.push_back(i);
+                commandCount += meshes[i].indexRanges.size();
+            }
+            batch.commandCount = (GLsizei)(commandCount - batch.firstCommand);
+            indirectBatches.push_back(batch);
         }
-        // now wak through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
-        for(unsigned int i = 0; i < mesh->mNumFaces; i++)
+        vector<DrawElementsIndirectCommand> commands;
+        vector<IndirectInstance> instances;
+        fillIndirect(nullptr, 1, commands, instances);
+
+        if (!indirectCommandBuffer)
         {
-            aiFace face = mesh->mFaces[i];
-            // retrieve all indices of the face and store them in the indices vector
-            for(unsigned int j = 0; j < face.mNumIndices; j++)
-                indices.push_back(face.mIndices[j]);
+            glGenBuffers(1, &indirectCommandBuffer);
+            glGenBuffers(1, &indirectInstanceBuffer);
         }
-        // process materials
-        aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-        // we assume a convention for sampler names in the shaders. Each diffuse texture should be named
-        // as 'texture_diffuseN' where N is a sequential number ranging from 1 to MAX_SAMPLER_NUMBER.
-        // Same applies to other texture as the following list summarizes:
-        // diffuse: texture_diffuseN
-        // specular: texture_specularN
-        // normal: texture_normalN
-        aiColor3D color(0.0f, 0.0f, 0.0f);
-        material->Get(AI_MATKEY_COLOR_AMBIENT, color);
-
-
-        // 1. diffuse maps
-        vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-        textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
-        // 2. specular maps
-        vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-        textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
-        // 3. normal maps
-        std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
-        textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
-        // 4. height maps
-        std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
-        textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
-
-
-
-        // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        glState.bindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectCommandBuffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data(), GL_STATIC_DRAW);
+        glState.bindBuffer(GL_ARRAY_BUFFER, indirectInstanceBuffer);
+        glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(IndirectInstance), instances.data(), GL_STATIC_DRAW);
+        indirectGeneration = arena->layoutGeneration();
+        return true;
+    }
+
+    // meshes in texture arrays can be drawn together whenever they use the same arrays, whatever their layers; the
+    // rest of the material has to match too, only the layers travel per draw
+    static bool sameMaterial(const Mesh &a, const Mesh &b)
+    {
+        if (a.material == b.material)
+            return true;
+        if (!a.material || !b.material)
+            return false;
+        return a.material->sameTextures(*b.material) && a.material->shininess == b.material->shininess &&
+               a.material->cullFace == b.material->cullFace;
+    }
+
+    // the material equal to material if the model has one already, otherwise a new one
+    const Material *addMaterial(const Material &material)
+    {
+        for (const unique_ptr<Material> &existing : materials)
+            if (*existing == material)
+                return existing.get();
+        materials.emplace_back(new Material(material));
+        return materials.back().get();
     }
 
-    // checks all material textures of a given type and loads the textures if they're not loaded yet.
-    // the required info is returned as a Texture struct.
-    vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
+    // material texture types are named like the sampler uniforms, see ModelImporter::processMesh
+    static TextureRole textureRole(const string &typeName)
     {
-        vector<Texture> textures;
-        for(unsigned int i = 0; i < mat->GetTextureCount(type); i++)
+        if (typeName == "texture_normal")
+            return TextureRole::Normal;
+        if (typeName == "texture_height")
+            return TextureRole::Height;
+        if (typeName == "texture_specular")
+            return TextureRole::Specular;
+        return TextureRole::Albedo;
+    }
+
+    // groups the material textures of the imported meshes by type, size and format and loads every group as one texture
+    // array, so meshes whose textures differ are still drawn without changing texture bindings. the sizes come from
+    // the image headers. a mesh is packed only if all its textures can be: one texture per MATERIAL_TEXTURE_TYPES
+    // entry, with a readable header.
+    vector<MaterialArrayRefs> packTextureArrays(const ModelData &data, TextureCache &textureCache)
+    {
+        struct ArrayGroup {
+            unsigned int type;
+            int width, height;
+            GLenum internalFormat;
+            vector<string> paths;
+        };
+        vector<ArrayGroup> groups;
+        vector<MaterialArrayRefs> refs(data.meshes.size());
+        size_t textureCount = 0;
+        for (size_t m = 0; m < data.meshes.size(); m++)
         {
-            aiString str;
-            mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for(unsigned int j = 0; j < textures_loaded.size(); j++)
+            // resolve every texture first, a mesh that can't be packed must not add layers
+            vector<ArrayGroup> wanted;
+            bool packable = true;
+            for (const TextureRef &reference : data.meshes[m].textures)
             {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
+                unsigned int type = 0;
+                while (type < MATERIAL_TEXTURE_TYPE_COUNT && reference.type != MATERIAL_TEXTURE_TYPES[type])
+                    type++;
+                ArrayGroup texture;
+                texture.type = type;
+                string path = this->directory + '/' + reference.path;
+                int channels;
+                if (type == MATERIAL_TEXTURE_TYPE_COUNT || !ReadImageInfo(path, texture.width, texture.height, channels))
                 {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
+                    packable = false;
                     break;
                 }
+                for (const ArrayGroup &other : wanted)
+                    packable = packable && other.type != type;
+                TextureRole role = textureRole(reference.type);
+                int bytesPerChannel = role == TextureRole::Height && IsSixteenBitPng(path) ? 2 : 1;
+                texture.internalFormat = ChooseTextureFormat(role, false, channels, bytesPerChannel).internalFormat;
+                texture.paths.push_back(path);
+                wanted.push_back(texture);
             }
-            if(!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
+            if (!packable)
+                continue;
+
+            refs[m].packed = true;
+            for (const ArrayGroup &texture : wanted)
+            {
+                size_t group = 0;
+                for (; group < groups.size(); group++)
+                    if (groups[group].type == texture.type && groups[group].width == texture.width &&
+                        groups[group].height == texture.height && groups[group].internalFormat == texture.internalFormat)
+                        break;
+                if (group == groups.size())
+                {
+                    groups.push_back(texture);
+                    groups.back().paths.clear();
+                }
+                vector<string> &paths = groups[group].paths;
+                size_t layer = find(paths.begin(), paths.end(), texture.paths[0]) - paths.begin();
+                if (layer == paths.size())
+                {
+                    paths.push_back(texture.paths[0]);
+                    textureCount++;
+                }
+                refs[m].array[texture.type] = (int)(textureArrays_loaded.size() + group);
+                refs[m].layer[texture.type] = (int)layer;
             }
         }
-        return textures;
+
+        for (const ArrayGroup &group : groups)
+        {
+            TextureSettings settings;
+            settings.role = textureRole(MATERIAL_TEXTURE_TYPES[group.type]);
+            settings.clampIfAlpha = true;
+            textureArrays_loaded.push_back(textureCache.acquireArray(group.paths, settings));
+        }
+        if (!groups.empty())
+            cout << "MODEL:: " << data.path << " " << textureCount << " material textures in " << groups.size()
+                 << " texture arrays" << endl;
+        return refs;
+    }
+
+    // uploads a texture referenced by a material, unless a texture with the same path was uploaded before
+    Texture loadTexture(const string &path, const string &typeName, TextureCache *textureCache)
+    {
+        // check if texture was loaded before and if so, reuse it: skip loading a new texture
+        auto loaded = loadedTextureIndex.find(path);
+        if (loaded != loadedTextureIndex.end())
+        {
+            Texture texture = textures_loaded[loaded->second];
+            texture.type = typeName;
+            return texture;
+        }
+        // if texture hasn't been loaded by this model, load it (or take it from the cache when another user has)
+        Texture texture;
+        if (textureCache)
+        {
+            TextureSettings settings;
+            settings.role = textureRole(typeName);
+            settings.clampIfAlpha = true;
+            texture.id = textureCache->acquire(this->directory + '/' + path, settings);
+        }
+        else
+            texture.id = TextureFromFile(path.c_str(), this->directory);
+        texture.type = typeName;
+        texture.path = path;
+        loadedTextureIndex[path] = textures_loaded.size();
+        textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
+        return texture;
     }
 };
 
@@ -221,37 +625,38 @@ unsigned int TextureFromFile(const char *path, const string &directory, bool gam
     string filename = string(path);
     filename = directory + '/' + filename;
 
+    DecodedImage image = DecodeImage(filename, true);
+    if (!image.pixels)
+    {
+        std::cout << "Texture failed to load at path: " << path << std::endl;
+        unsigned int textureID;
+        glGenTextures(1, &textureID);
+        return textureID;
+    }
+    return TextureFromImage(image);
+}
+
+unsigned int TextureFromImage(const DecodedImage &image)
+{
     unsigned int textureID;
     glGenTextures(1, &textureID);
 
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
+    GLenum format;
+    if (image.channels == 1)
+        format = GL_RED;
+    else if (image.channels == 3)
+        format = GL_RGB;
     else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
+        format = GL_RGBA;
+
+    glState.bindTexture(GL_TEXTURE_2D, textureID);
+    glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.pixels.get());
+    glGenerateMipmap(GL_TEXTURE_2D);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
     return textureID;
 }
@@ -0,0 +1,380 @@
+#ifndef MODEL_CACHE_H
+#define MODEL_CACHE_H
+
+#include <learnopengl/mapped_file.h>
+#include <learnopengl/mesh_data.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+// directory (relative to the working directory, like program_state.txt) that holds the binary mesh caches
+const char *const MODEL_CACHE_DIRECTORY = "resources/cache/models";
+
+// bump whenever the on-disk layout or the import pipeline changes, every existing cache file is then treated as stale
+const uint32_t MODEL_CACHE_VERSION = 5;
+const uint32_t MODEL_CACHE_MAGIC = 0x4D434752; // "RGCM"
+
+// the vertex array is written and mapped back verbatim, so its layout is part of the file format
+static_assert(sizeof(Vertex) == 14 * sizeof(float), "Vertex layout changed, bump MODEL_CACHE_VERSION");
+
+// on-disk layout: header, mesh table, part table, instance table, texture table, vertices, indices, string pool.
+// every section offset is relative to the start of the file and 8 byte aligned.
+struct ModelCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t sourceHash;        // hash of the model file, its material libraries, the import flags and options
+    uint32_t meshCount;
+    uint32_t textureCount;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t partCount;
+    uint32_t instanceCount;
+    uint64_t meshOffset;
+    uint64_t partOffset;
+    uint64_t instanceOffset;
+    uint64_t textureOffset;
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    uint64_t stringOffset;
+    uint64_t stringSize;
+    float boundsMin[3];
+    float boundsMax[3];
+};
+
+struct ModelCacheMesh {
+    uint32_t firstVertex;
+    uint32_t vertexCount;
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    uint32_t firstTexture;
+    uint32_t textureCount;
+    uint32_t firstPart;
+    uint32_t partCount;
+    uint32_t firstInstance;
+    uint32_t instanceCount;
+    uint32_t nameOffset;
+    uint32_t nameLength;
+    float boundsMin[3];
+    float boundsMax[3];
+};
+
+// see MeshPart; firstIndex is relative to the owning mesh
+struct ModelCachePart {
+    uint32_t nameOffset;
+    uint32_t nameLength;
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    float boundsMin[3];
+    float boundsMax[3];
+};
+
+// column major, like glm::mat4
+struct ModelCacheInstance {
+    float transform[16];
+};
+
+// texture references are stored as (type, path) pairs pointing into the string pool
+struct ModelCacheTexture {
+    uint32_t typeOffset;
+    uint32_t typeLength;
+    uint32_t pathOffset;
+    uint32_t pathLength;
+};
+
+// a validated cache file; all pointers point straight into the mapping so nothing is copied on load
+struct ModelCacheView {
+    MappedFile file;
+    const ModelCacheHeader *header = nullptr;
+    const ModelCacheMesh *meshes = nullptr;
+    const ModelCachePart *parts = nullptr;
+    const ModelCacheInstance *instances = nullptr;
+    const ModelCacheTexture *textures = nullptr;
+    const Vertex *vertices = nullptr;
+    const unsigned int *indices = nullptr;
+    const char *strings = nullptr;
+
+    string poolString(uint32_t offset, uint32_t length) const
+    {
+        return string(strings + offset, length);
+    }
+};
+
+class ModelCache
+{
+public:
+    // key of a model: its source file, the material libraries it references, the post-process flags and the
+    // ModelImporter options it is imported with. returns 0 when the source file can't be read.
+    static uint64_t sourceHash(const string &path, unsigned int importFlags, unsigned int importOptions)
+    {
+        MappedFile source;
+        if (!source.open(path))
+            return 0;
+        uint64_t hash = HashBytes(&MODEL_CACHE_VERSION, sizeof(MODEL_CACHE_VERSION));
+        hash = HashBytes(&importFlags, sizeof(importFlags), hash);
+        hash = HashBytes(&importOptions, sizeof(importOptions), hash);
+        hash = HashBytes(source.data(), source.size(), hash);
+
+        // OBJ material libraries feed the imported textures, so editing one must invalidate the cache as well
+        string directory = path.substr(0, path.find_last_of('/'));
+        const char *text = reinterpret_cast<const char *>(source.data());
+        const char *end = text + source.size();
+        for (const char *line = text; line < end; )
+        {
+            const char *lineEnd = static_cast<const char *>(memchr(line, '\n', end - line));
+            if (!lineEnd)
+                lineEnd = end;
+            if (lineEnd - line > 7 && strncmp(line, "mtllib ", 7) == 0)
+            {
+                string library(line + 7, lineEnd);
+                while (!library.empty() && (library.back() == '\r' || library.back() == ' '))
+                    library.pop_back();
+                MappedFile materials;
+                if (materials.open(directory + '/' + library))
+                    hash = HashBytes(materials.data(), materials.size(), hash);
+            }
+            line = lineEnd + 1;
+        }
+        // 0 is reserved for "unreadable"
+        return hash ? hash : 1;
+    }
+
+    // cache file for a model path: readable stem plus a hash of the full path so equally named models don't collide.
+    // each set of import options gets its own file, so loading a model both ways doesn't rebuild the cache every time.
+    static string cachePath(const string &modelPath, unsigned int importOptions)
+    {
+        size_t slash = modelPath.find_last_of('/');
+        string stem = modelPath.substr(slash == string::npos ? 0 : slash + 1);
+        stem = stem.substr(0, stem.find_last_of('.'));
+        for (char &c : stem)
+            if (c == ' ')
+                c = '_';
+        char suffix[17];
+        uint64_t hash = HashBytes(modelPath.data(), modelPath.size());
+        hash = HashBytes(&importOptions, sizeof(importOptions), hash);
+        snprintf(suffix, sizeof(suffix), "%016llx", (unsigned long long)hash);
+        return string(MODEL_CACHE_DIRECTORY) + '/' + stem + '-' + suffix + ".meshcache";
+    }
+
+    // maps a cache file and checks that it is complete and was built from the current sources.
+    // stale, truncated or foreign files are rejected so the caller falls back to a full import.
+    static bool open(const string &path, uint64_t sourceHash, ModelCacheView &view)
+    {
+        if (sourceHash == 0 || !view.file.open(path))
+            return false;
+        const unsigned char *base = view.file.data();
+        size_t size = view.file.size();
+        if (size < sizeof(ModelCacheHeader))
+            return false;
+        const ModelCacheHeader *header = reinterpret_cast<const ModelCacheHeader *>(base);
+        if (header->magic != MODEL_CACHE_MAGIC || header->version != MODEL_CACHE_VERSION || header->sourceHash != sourceHash)
+            return false;
+        if (!sectionFits(header->meshOffset, (uint64_t)header->meshCount * sizeof(ModelCacheMesh), size) ||
+            !sectionFits(header->partOffset, (uint64_t)header->partCount * sizeof(ModelCachePart), size) ||
+            !sectionFits(header->instanceOffset, (uint64_t)header->instanceCount * sizeof(ModelCacheInstance), size) ||
+            !sectionFits(header->textureOffset, (uint64_t)header->textureCount * sizeof(ModelCacheTexture), size) ||
+            !sectionFits(header->vertexOffset, (uint64_t)header->vertexCount * sizeof(Vertex), size) ||
+            !sectionFits(header->indexOffset, (uint64_t)header->indexCount * sizeof(unsigned int), size) ||
+            !sectionFits(header->stringOffset, header->stringSize, size))
+            return false;
+
+        view.header = header;
+        view.meshes = reinterpret_cast<const ModelCacheMesh *>(base + header->meshOffset);
+        view.parts = reinterpret_cast<const ModelCachePart *>(base + header->partOffset);
+        view.instances = reinterpret_cast<const ModelCacheInstance *>(base + header->instanceOffset);
+        view.textures = reinterpret_cast<const ModelCacheTexture *>(base + header->textureOffset);
+        view.vertices = reinterpret_cast<const Vertex *>(base + header->vertexOffset);
+        view.indices = reinterpret_cast<const unsigned int *>(base + header->indexOffset);
+        view.strings = reinterpret_cast<const char *>(base + header->stringOffset);
+
+        for (uint32_t i = 0; i < header->meshCount; i++)
+        {
+            const ModelCacheMesh &mesh = view.meshes[i];
+            if ((uint64_t)mesh.firstVertex + mesh.vertexCount > header->vertexCount ||
+                (uint64_t)mesh.firstIndex + mesh.indexCount > header->indexCount ||
+                (uint64_t)mesh.firstTexture + mesh.textureCount > header->textureCount ||
+                (uint64_t)mesh.firstPart + mesh.partCount > header->partCount ||
+                (uint64_t)mesh.firstInstance + mesh.instanceCount > header->instanceCount ||
+                (uint64_t)mesh.nameOffset + mesh.nameLength > header->stringSize)
+                return false;
+            for (uint32_t p = mesh.firstPart; p < mesh.firstPart + mesh.partCount; p++)
+            {
+                const ModelCachePart &part = view.parts[p];
+                if ((uint64_t)part.firstIndex + part.indexCount > mesh.indexCount ||
+                    (uint64_t)part.nameOffset + part.nameLength > header->stringSize)
+                    return false;
+            }
+        }
+        for (uint32_t i = 0; i < header->textureCount; i++)
+        {
+            const ModelCacheTexture &texture = view.textures[i];
+            if ((uint64_t)texture.typeOffset + texture.typeLength > header->stringSize ||
+                (uint64_t)texture.pathOffset + texture.pathLength > header->stringSize)
+                return false;
+        }
+        return true;
+    }
+
+    // serializes freshly imported meshes. the file is written next to its final name and renamed into place,
+    // so a crash or a concurrent reader never sees a half written cache.
+    static bool write(const string &path, uint64_t sourceHash, const vector<MeshData> &meshes)
+    {
+        if (sourceHash == 0 || !MakeDirectories(path.substr(0, path.find_last_of('/'))))
+            return false;
+
+        vector<ModelCacheMesh> meshTable;
+        vector<ModelCachePart> partTable;
+        vector<ModelCacheInstance> instanceTable;
+        vector<ModelCacheTexture> textureTable;
+        string strings;
+        uint32_t vertexCount = 0, indexCount = 0;
+        glm::vec3 boundsMin(0.0f), boundsMax(0.0f);
+        for (const MeshData &mesh : meshes)
+        {
+            ModelCacheMesh entry;
+            entry.firstVertex = vertexCount;
+            entry.vertexCount = mesh.vertexCount();
+            entry.firstIndex = indexCount;
+            entry.indexCount = mesh.indexCount();
+            entry.firstTexture = (uint32_t)textureTable.size();
+            entry.textureCount = (uint32_t)mesh.textures.size();
+            entry.firstPart = (uint32_t)partTable.size();
+            entry.partCount = (uint32_t)mesh.parts.size();
+            entry.firstInstance = (uint32_t)instanceTable.size();
+            entry.instanceCount = (uint32_t)mesh.instances.size();
+            addString(strings, mesh.name, entry.nameOffset, entry.nameLength);
+            for (int k = 0; k < 3; k++)
+            {
+                entry.boundsMin[k] = mesh.boundsMin[k];
+                entry.boundsMax[k] = mesh.boundsMax[k];
+            }
+            boundsMin = meshTable.empty() ? mesh.boundsMin : glm::min(boundsMin, mesh.boundsMin);
+            boundsMax = meshTable.empty() ? mesh.boundsMax : glm::max(boundsMax, mesh.boundsMax);
+            meshTable.push_back(entry);
+            vertexCount += entry.vertexCount;
+            indexCount += entry.indexCount;
+
+            for (const MeshPart &part : mesh.parts)
+            {
+                ModelCachePart reference;
+                addString(strings, part.name, reference.nameOffset, reference.nameLength);
+                reference.firstIndex = part.firstIndex;
+                reference.indexCount = part.indexCount;
+                for (int k = 0; k < 3; k++)
+                {
+                    reference.boundsMin[k] = part.boundsMin[k];
+                    reference.boundsMax[k] = part.boundsMax[k];
+                }
+                partTable.push_back(reference);
+            }
+            for (const glm::mat4 &transform : mesh.instances)
+            {
+                ModelCacheInstance instance;
+                for (int c = 0; c < 4; c++)
+                    for (int r = 0; r < 4; r++)
+                        instance.transform[c * 4 + r] = transform[c][r];
+                instanceTable.push_back(instance);
+            }
+            for (const TextureRef &texture : mesh.textures)
+            {
+                ModelCacheTexture reference;
+                addString(strings, texture.type, reference.typeOffset, reference.typeLength);
+                addString(strings, texture.path, reference.pathOffset, reference.pathLength);
+                textureTable.push_back(reference);
+            }
+        }
+
+        ModelCacheHeader header;
+        memset(&header, 0, sizeof(header));
+        header.magic = MODEL_CACHE_MAGIC;
+        header.version = MODEL_CACHE_VERSION;
+        header.sourceHash = sourceHash;
+        header.meshCount = (uint32_t)meshTable.size();
+        header.textureCount = (uint32_t)textureTable.size();
+        header.vertexCount = vertexCount;
+        header.indexCount = indexCount;
+        header.partCount = (uint32_t)partTable.size();
+        header.instanceCount = (uint32_t)instanceTable.size();
+        header.meshOffset = align(sizeof(ModelCacheHeader));
+        header.partOffset = align(header.meshOffset + meshTable.size() * sizeof(ModelCacheMesh));
+        header.instanceOffset = align(header.partOffset + partTable.size() * sizeof(ModelCachePart));
+        header.textureOffset = align(header.instanceOffset + instanceTable.size() * sizeof(ModelCacheInstance));
+        header.vertexOffset = align(header.textureOffset + textureTable.size() * sizeof(ModelCacheTexture));
+        header.indexOffset = align(header.vertexOffset + (uint64_t)vertexCount * sizeof(Vertex));
+        header.stringOffset = align(header.indexOffset + (uint64_t)indexCount * sizeof(unsigned int));
+        header.stringSize = strings.size();
+        for (int k = 0; k < 3; k++)
+        {
+            header.boundsMin[k] = boundsMin[k];
+            header.boundsMax[k] = boundsMax[k];
+        }
+
+        string temporaryPath = path + ".tmp";
+        {
+            ofstream out(temporaryPath, ios::binary | ios::trunc);
+            if (!out)
+                return false;
+            writeSection(out, 0, &header, sizeof(header));
+            writeSection(out, header.meshOffset, meshTable.data(), meshTable.size() * sizeof(ModelCacheMesh));
+            writeSection(out, header.partOffset, partTable.data(), partTable.size() * sizeof(ModelCachePart));
+            writeSection(out, header.instanceOffset, instanceTable.data(), instanceTable.size() * sizeof(ModelCacheInstance));
+            writeSection(out, header.textureOffset, textureTable.data(), textureTable.size() * sizeof(ModelCacheTexture));
+            writeSection(out, header.vertexOffset, nullptr, 0);
+            for (const MeshData &mesh : meshes)
+                out.write(reinterpret_cast<const char *>(mesh.vertexData()), (size_t)mesh.vertexCount() * sizeof(Vertex));
+            writeSection(out, header.indexOffset, nullptr, 0);
+            for (const MeshData &mesh : meshes)
+                out.write(reinterpret_cast<const char *>(mesh.indexData()), (size_t)mesh.indexCount() * sizeof(unsigned int));
+            writeSection(out, header.stringOffset, strings.data(), strings.size());
+            if (!out)
+            {
+                out.close();
+                remove(temporaryPath.c_str());
+                return false;
+            }
+        }
+        if (rename(temporaryPath.c_str(), path.c_str()) != 0)
+        {
+            remove(temporaryPath.c_str());
+            return false;
+        }
+        return true;
+    }
+
+private:
+    static uint64_t align(uint64_t offset)
+    {
+        return (offset + 7) & ~(uint64_t)7;
+    }
+
+    static void addString(string &pool, const string &text, uint32_t &offset, uint32_t &length)
+    {
+        offset = (uint32_t)pool.size();
+        length = (uint32_t)text.size();
+        pool += text;
+    }
+
+    static bool sectionFits(uint64_t offset, uint64_t size, size_t fileSize)
+    {
+        return offset % 8 == 0 && offset <= fileSize && size <= fileSize - offset;
+    }
+
+    // pads the stream up to offset before writing the section
+    static void writeSection(ofstream &out, uint64_t offset, const void *data, size_t size)
+    {
+        static const char zeros[8] = {0};
+        uint64_t position = (uint64_t)out.tellp();
+        if (offset > position)
+            out.write(zeros, offset - position);
+        if (size)
+            out.write(static_cast<const char *>(data), size);
+    }
+
+};
+
+#endif
@@ -0,0 +1,324 @@
+#ifndef MODEL_IMPORTER_H
+#define MODEL_IMPORTER_H
+
+#include <glm/glm.hpp>
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+#include <learnopengl/mesh_data.h>
+#include <learnopengl/model_cache.h>
+#include <learnopengl/mesh_processing.h>
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+using namespace std;
+
+// post-processing every model is imported with. part of the mesh cache key, so changing it invalidates cached models.
+const unsigned int MODEL_IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
+
+// ModelImporter options, combined with |. they are part of the mesh cache key as well.
+// MODEL_IMPORT_MERGE_BY_MATERIAL: merge meshes sharing a material into one mesh, see MergeMeshesByMaterial
+// MODEL_IMPORT_INSTANCE_DUPLICATES: store repeated meshes once and draw them instanced, see InstanceDuplicateMeshes.
+//     shaders drawing such a model have to apply the per instance transform (aInstance, see light.vs)
+const unsigned int MODEL_IMPORT_MERGE_BY_MATERIAL = 1u << 0;
+const unsigned int MODEL_IMPORT_INSTANCE_DUPLICATES = 1u << 1;
+
+// everything importing a model produces before any OpenGL object exists. built by ModelImporter::Import on any
+// thread, turned into GPU resources by Model::upload on the GL thread.
+struct ModelData {
+    string path;
+    string directory;
+    vector<MeshData> meshes;
+    unique_ptr<ModelCacheView> cache;   // keeps the mapped cache file alive while meshes point into it
+    bool valid = false;
+    bool fromCache = false;
+    double importMilliseconds = 0.0;
+};
+
+// Assimp / mesh cache side of model loading. OpenGL free, so it runs on worker threads (see ModelLoader)
+// and in tools or tests without a GL context.
+class ModelImporter
+{
+public:
+    // CPU half of loading a model: reads the meshes from the binary mesh cache when it is current, otherwise through
+    // Assimp, refreshing the cache. never touches OpenGL, so it may run on a worker thread.
+    static ModelData Import(string const &path, unsigned int options = 0)
+    {
+        auto start = chrono::steady_clock::now();
+        // composed up front so lines of concurrent imports don't interleave
+        ostringstream message;
+        ModelData data;
+        data.path = path;
+        // retrieve the directory path of the filepath
+        data.directory = path.substr(0, path.find_last_of('/'));
+
+        // warm start: map the binary cache written by a previous import, if it still matches the sources
+        uint64_t sourceHash = ModelCache::sourceHash(path, MODEL_IMPORT_FLAGS, options);
+        string cachePath = ModelCache::cachePath(path, options);
+        data.fromCache = readCache(cachePath, sourceHash, data);
+        if (!data.fromCache)
+        {
+            // read file via ASSIMP
+            Assimp::Importer importer;
+            const aiScene* scene = importer.ReadFile(path, MODEL_IMPORT_FLAGS);
+            // check for errors
+            if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
+            {
+                cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
+                return data;
+            }
+
+            // process ASSIMP's root node recursively
+            processNode(scene->mRootNode, scene, data);
+            if (options & MODEL_IMPORT_INSTANCE_DUPLICATES)
+                instanceDuplicates(data, message);
+            processMeshes(data, message);
+            if (options & MODEL_IMPORT_MERGE_BY_MATERIAL)
+            {
+                size_t sourceMeshes = data.meshes.size();
+                MergeMeshesByMaterial(data.meshes);
+                message << "MODEL:: " << path << " merged " << sourceMeshes << " meshes into " << data.meshes.size()
+                        << " by material\n";
+            }
+
+            if (!ModelCache::write(cachePath, sourceHash, data.meshes))
+                cout << "WARNING::MODEL_CACHE:: could not write " << cachePath << endl;
+        }
+
+        data.valid = true;
+        data.importMilliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        message << "MODEL:: " << path << " imported in " << data.importMilliseconds << " ms ("
+                << (data.fromCache ? "warm mesh cache" : "cold, imported with Assimp") << ")\n";
+        cout << message.str() << flush;
+        return data;
+    }
+
+private:
+    static void instanceDuplicates(ModelData &data, ostringstream &message)
+    {
+        size_t sourceMeshes = data.meshes.size(), sourceVertices = 0, keptVertices = 0, prototypes = 0;
+        for (const MeshData &mesh : data.meshes)
+            sourceVertices += mesh.vertexCount();
+        unsigned int removed = InstanceDuplicateMeshes(data.meshes);
+        for (const MeshData &mesh : data.meshes)
+        {
+            keptVertices += mesh.vertexCount();
+            prototypes += !mesh.instances.empty();
+        }
+        message << "MODEL:: " << data.path << " " << removed << " of " << sourceMeshes << " meshes are instances of "
+                << prototypes << " prototypes (" << sourceVertices << " -> " << keptVertices << " vertices)\n";
+    }
+
+    // import time passes (see mesh_processing.h), logging what each did per mesh
+    static void processMeshes(ModelData &data, ostringstream &message)
+    {
+        for (size_t i = 0; i < data.meshes.size(); i++)
+        {
+            MeshData &mesh = data.meshes[i];
+            WeldStats weld = WeldVertices(mesh);
+            VertexCacheStats before = AnalyzeVertexCache(mesh.indices, mesh.vertexCount());
+            OptimizeVertexCache(mesh.indices, mesh.vertexCount());
+            OptimizeOverdraw(mesh.indices, mesh.vertices);
+            OptimizeVertexFetch(mesh);
+            VertexCacheStats after = AnalyzeVertexCache(mesh.indices, mesh.vertexCount());
+
+            message << "MODEL:: " << data.path << " mesh " << i << ": welded " << weld.verticesBefore << " -> "
+                    << weld.verticesAfter << " vertices (" << weld.verticesBefore * sizeof(Vertex) / 1024 << " KB -> "
+                    << weld.verticesAfter * sizeof(Vertex) / 1024 << " KB), ACMR " << before.acmr << " -> " << after.acmr
+                    << ", ATVR " << before.atvr << " -> " << after.atvr << "\n";
+        }
+    }
+
+    // fills data with meshes pointing into a mapped cache file; false when the cache is missing or stale
+    static bool readCache(const string &cachePath, uint64_t sourceHash, ModelData &data)
+    {
+        unique_ptr<ModelCacheView> cache(new ModelCacheView());
+        if (!ModelCache::open(cachePath, sourceHash, *cache))
+            return false;
+
+        data.meshes.resize(cache->header->meshCount);
+        for (uint32_t i = 0; i < cache->header->meshCount; i++)
+        {
+            const ModelCacheMesh &entry = cache->meshes[i];
+            MeshData &mesh = data.meshes[i];
+            mesh.mappedVertices = cache->vertices + entry.firstVertex;
+            mesh.mappedVertexCount = entry.vertexCount;
+            mesh.mappedIndices = cache->indices + entry.firstIndex;
+            mesh.mappedIndexCount = entry.indexCount;
+            mesh.boundsMin = glm::vec3(entry.boundsMin[0], entry.boundsMin[1], entry.boundsMin[2]);
+            mesh.boundsMax = glm::vec3(entry.boundsMax[0], entry.boundsMax[1], entry.boundsMax[2]);
+            mesh.name = cache->poolString(entry.nameOffset, entry.nameLength);
+            for (uint32_t n = entry.firstInstance; n < entry.firstInstance + entry.instanceCount; n++)
+            {
+                glm::mat4 transform;
+                for (int c = 0; c < 4; c++)
+                    for (int r = 0; r < 4; r++)
+                        transform[c][r] = cache->instances[n].transform[c * 4 + r];
+                mesh.instances.push_back(transform);
+            }
+            for (uint32_t p = entry.firstPart; p < entry.firstPart + entry.partCount; p++)
+            {
+                const ModelCachePart &reference = cache->parts[p];
+                MeshPart part;
+                part.name = cache->poolString(reference.nameOffset, reference.nameLength);
+                part.firstIndex = reference.firstIndex;
+                part.indexCount = reference.indexCount;
+                part.boundsMin = glm::vec3(reference.boundsMin[0], reference.boundsMin[1], reference.boundsMin[2]);
+                part.boundsMax = glm::vec3(reference.boundsMax[0], reference.boundsMax[1], reference.boundsMax[2]);
+                mesh.parts.push_back(part);
+            }
+            for (uint32_t t = entry.firstTexture; t < entry.firstTexture + entry.textureCount; t++)
+            {
+                const ModelCacheTexture &reference = cache->textures[t];
+                TextureRef texture;
+                texture.type = cache->poolString(reference.typeOffset, reference.typeLength);
+                texture.path = cache->poolString(reference.pathOffset, reference.pathLength);
+                mesh.textures.push_back(texture);
+            }
+        }
+        data.cache = std::move(cache);
+        return true;
+    }
+
+    // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
+    static void processNode(aiNode *node, const aiScene *scene, ModelData &data)
+    {
+        // process each mesh located at the current node
+        for(unsigned int i = 0; i < node->mNumMeshes; i++)
+        {
+            // the node object only contains indices to index the actual objects in the scene.
+            // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
+            aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
+            data.meshes.push_back(processMesh(mesh, scene));
+        }
+        // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
+        for(unsigned int i = 0; i < node->mNumChildren; i++)
+        {
+            processNode(node->mChildren[i], scene, data);
+        }
+
+    }
+
+    static MeshData processMesh(aiMesh *mesh, const aiScene *scene)
+    {
+        // data to fill
+        MeshData data;
+        data.name = mesh->mName.C_Str();
+        vector<Vertex> &vertices = data.vertices;
+        vector<unsigned int> &indices = data.indices;
+        vector<TextureRef> &textures = data.textures;
+
+        // walk through each of the mesh's vertices
+        for(unsigned int i = 0; i < mesh->mNumVertices; i++)
+        {
+            Vertex vertex;
+            glm::vec3 vector; // we declare a placeholder vector since assimp_ uses its own vector class that doesn't directly convert to glm's vec3 class so we transfer the data to this placeholder glm::vec3 first.
+            // positions
+            vector.x = mesh->mVertices[i].x;
+            vector.y = mesh->mVertices[i].y;
+            vector.z = mesh->mVertices[i].z;
+            vertex.Position = vector;
+            // normals
+            if (mesh->HasNormals())
+            {
+                vector.x = mesh->mNormals[i].x;
+                vector.y = mesh->mNormals[i].y;
+                vector.z = mesh->mNormals[i].z;
+                vertex.Normal = vector;
+            }
+            // texture coordinates
+            if(mesh->mTextureCoords[0]) // does the mesh contain texture coordinates?
+            {
+                glm::vec2 vec;
+                // a vertex can contain up to 8 different texture coordinates. We thus make the assumption that we won't
+                // use models where a vertex can have multiple texture coordinates so we always take the first set (0).
+                vec.x = mesh->mTextureCoords[0][i].x;
+                vec.y = mesh->mTextureCoords[0][i].y;
+                vertex.TexCoords = vec;
+                // tangent
+                vector.x = mesh->mTangents[i].x;
+                vector.y = mesh->mTangents[i].y;
+                vector.z = mesh->mTangents[i].z;
+                vertex.Tangent = vector;
+                // bitangent
+                vector.x = mesh->mBitangents[i].x;
+                vector.y = mesh->mBitangents[i].y;
+                vector.z = mesh->mBitangents[i].z;
+                vertex.Bitangent = vector;
+            }
+            else
+            {
+                vertex.TexCoords = glm::vec2(0.0f, 0.0f);
+                // defined values, welding compares whole vertices
+                vertex.Tangent = glm::vec3(0.0f);
+                vertex.Bitangent = glm::vec3(0.0f);
+            }
+
+            vertices.push_back(vertex);
+
+
+        }
+        // now wak through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
+        for(unsigned int i = 0; i < mesh->mNumFaces; i++)
+        {
+            aiFace face = mesh->mFaces[i];
+            // retrieve all indices of the face and store them in the indices vector
+            for(unsigned int j = 0; j < face.mNumIndices; j++)
+                indices.push_back(face.mIndices[j]);
+        }
+        // process materials
+        aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+        // we assume a convention for sampler names in the shaders. Each diffuse texture should be named
+        // as 'texture_diffuseN' where N is a sequential number ranging from 1 to MAX_SAMPLER_NUMBER.
+        // Same applies to other texture as the following list summarizes:
+        // diffuse: texture_diffuseN
+        // specular: texture_specularN
+        // normal: texture_normalN
+        aiColor3D color(0.0f, 0.0f, 0.0f);
+        material->Get(AI_MATKEY_COLOR_AMBIENT, color);
+
+
+        // 1. diffuse maps
+        vector<TextureRef> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
+        textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+        // 2. specular maps
+        vector<TextureRef> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
+        textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+        // 3. normal maps
+        std::vector<TextureRef> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
+        textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
+        // 4. height maps
+        std::vector<TextureRef> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
+        textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
+
+
+
+        // return the extracted mesh data
+        data.computeBounds();
+        return data;
+    }
+
+    // collects all material textures of a given type.
+    // the required info is returned as TextureRef structs, the files themselves are loaded when the model is uploaded.
+    static vector<TextureRef> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
+    {
+        vector<TextureRef> textures;
+        for(unsigned int i = 0; i < mat->GetTextureCount(type); i++)
+        {
+            aiString str;
+            mat->GetTexture(type, i, &str);
+            TextureRef texture;
+            texture.type = typeName;
+            texture.path = str.C_Str();
+            textures.push_back(texture);
+        }
+        return textures;
+    }
+};
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef MODEL_LOADER_H
+#define MODEL_LOADER_H
+
+#include <learnopengl/geometry_arena.h>
+#include <learnopengl/model.h>
+#include <learnopengl/texture_cache.h>
+#include <learnopengl/thread_pool.h>
+
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+// imports models concurrently: Assimp (or the mesh cache) and texture decoding run on the worker pool,
+// while the GL thread only uploads each model once its import has finished.
+// all models are loaded in roughly the time of the slowest one instead of the sum of all of them.
+class ModelLoader
+{
+public:
+    // textures of the loaded models come from textures and their meshes are uploaded into geometry when given,
+    // see Model::upload
+    explicit ModelLoader(ThreadPool &pool, TextureCache *textures = nullptr, GeometryArena *geometry = nullptr)
+        : pool(pool), textures(textures), geometry(geometry) {}
+
+    // queues the import of path. target is filled in by uploadFinished()/finish(), so it has to stay alive until then.
+    // options are ModelImporter options (MODEL_IMPORT_*).
+    void load(Model &target, const string &path, unsigned int options = 0)
+    {
+        if (pending.empty() && uploaded == 0)
+            start = chrono::steady_clock::now();
+        PendingModel model;
+        model.target = &target;
+        model.result = pool.submit([path, options] { return ModelImporter::Import(path, options); });
+        pending.push_back(std::move(model));
+    }
+
+    // uploads every model whose import is done without blocking, returns how many are still being imported.
+    // meant to be called from the GL thread while it has other startup work to do.
+    size_t uploadFinished()
+    {
+        for (size_t i = 0; i < pending.size(); )
+        {
+            if (pending[i].result.wait_for(chrono::seconds(0)) == future_status::ready)
+            {
+                upload(pending[i]);
+                pending.erase(pending.begin() + i);
+            }
+            else
+                i++;
+        }
+        return pending.size();
+    }
+
+    // blocks until every queued model is imported and uploaded, then reports the timings
+    void finish()
+    {
+        while (uploadFinished() > 0)
+            pending.front().result.wait_for(chrono::milliseconds(1));
+
+        double wallClock = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        cout << "MODEL_LOADER:: " << uploaded << " models loaded in " << wallClock << " ms on " << pool.size()
+             << " workers (slowest import " << slowestImport << " ms, sum of imports " << totalImport << " ms, "
+             << cachedModels << " from the mesh cache)" << endl;
+        uploaded = cachedModels = 0;
+        slowestImport = totalImport = 0.0;
+    }
+
+private:
+    struct PendingModel {
+        Model *target;
+        future<ModelData> result;
+    };
+
+    ThreadPool &pool;
+    TextureCache *textures;
+    GeometryArena *geometry;
+    vector<PendingModel> pending;
+    chrono::steady_clock::time_point start;
+    unsigned int uploaded = 0;
+    unsigned int cachedModels = 0;
+    double slowestImport = 0.0;
+    double totalImport = 0.0;
+
+    void upload(PendingModel &model)
+    {
+        ModelData data = model.result.get();
+        model.target->upload(data, textures, geometry);
+        uploaded++;
+        cachedModels += data.fromCache;
+        slowestImport = max(slowestImport, data.importMilliseconds);
+        totalImport += data.importMilliseconds;
+    }
+};
+
+#endif
@@ -0,0 +1,174 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/gl_ext.h>
+#include <learnopengl/mapped_file.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+// directory (relative to the working directory) linked programs are cached in
+const char *const PROGRAM_CACHE_DIRECTORY = "resources/cache/programs";
+
+// bump whenever the file layout or the key changes
+const uint32_t PROGRAM_CACHE_VERSION = 1;
+const uint32_t PROGRAM_CACHE_MAGIC = 0x42504752; // "RGPB"
+
+// on-disk layout: the header, then the binary glGetProgramBinary returned
+struct ProgramCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;               // see ProgramCache::key
+    uint32_t binaryFormat;
+    uint32_t reserved;
+    uint64_t binarySize;
+};
+
+// how the programs of this run were built, printed by ProgramCache::report
+struct ProgramCacheStats {
+    unsigned int compiled = 0;
+    double compileMilliseconds = 0.0;
+    unsigned int loaded = 0;
+    double loadMilliseconds = 0.0;
+    unsigned int rejected = 0;      // binaries the driver refused, compiled from source instead
+};
+ProgramCacheStats programCacheStats;
+
+// linked programs saved with glGetProgramBinary (ARB_get_program_binary), so later runs skip compiling and linking.
+// a binary is only good for the driver that made it, so the key covers the driver strings besides the sources, and
+// the driver may still refuse it (after an update that kept the version string, say): Shader then compiles from
+// source and overwrites the file.
+class ProgramCache
+{
+public:
+    static bool enabled() { return glExtensions.programBinaries; }
+
+    // key of a program: the final source of every stage (includes and the variant's defines already pasted in, see
+    // LoadShaderSource) and the GL vendor, renderer and version. needs a current context.
+    static uint64_t key(const vector<string> &sources)
+    {
+        uint64_t hash = HashBytes(&PROGRAM_CACHE_VERSION, sizeof(PROGRAM_CACHE_VERSION));
+        const GLenum driverStrings[] = {GL_VENDOR, GL_RENDERER, GL_VERSION};
+        for (GLenum name : driverStrings)
+        {
+            const char *value = reinterpret_cast<const char *>(glGetString(name));
+            if (value)
+                hash = HashBytes(value, strlen(value) + 1, hash);
+        }
+        for (const string &source : sources)
+        {
+            uint64_t size = source.size();
+            hash = HashBytes(&size, sizeof(size), hash);
+            hash = HashBytes(source.data(), source.size(), hash);
+        }
+        return hash ? hash : 1;
+    }
+
+    static string cachePath(uint64_t key)
+    {
+        char name[17];
+        snprintf(name, sizeof(name), "%016llx", (unsigned long long)key);
+        return string(PROGRAM_CACHE_DIRECTORY) + '/' + name + ".bin";
+    }
+
+    // loads the cached binary into program (a new program object); false when there is none or the driver refuses it
+    static bool load(uint64_t key, GLuint program)
+    {
+        MappedFile file;
+        if (!enabled() || !file.open(cachePath(key)) || file.size() < sizeof(ProgramCacheHeader))
+            return false;
+        const ProgramCacheHeader *header = reinterpret_cast<const ProgramCacheHeader *>(file.data());
+        if (header->magic != PROGRAM_CACHE_MAGIC || header->version != PROGRAM_CACHE_VERSION || header->key != key ||
+            header->binarySize != file.size() - sizeof(ProgramCacheHeader))
+            return false;
+
+        glExtensions.programBinary(program, header->binaryFormat, file.data() + sizeof(ProgramCacheHeader),
+                                   (GLsizei)header->binarySize);
+        GLint linked = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (!linked)
+        {
+            programCacheStats.rejected++;
+            return false;
+        }
+        return true;
+    }
+
+    // call before linking a program that is going to be stored
+    static void prepare(GLuint program)
+    {
+        if (enabled())
+            glExtensions.programParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    // saves a linked program, to a temporary file renamed into place like ModelCache::write
+    static bool store(uint64_t key, GLuint program)
+    {
+        if (!enabled() || !MakeDirectories(PROGRAM_CACHE_DIRECTORY))
+            return false;
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+            return false;
+        vector<unsigned char> binary((size_t)length);
+        GLsizei written = 0;
+        GLenum format = 0;
+        glExtensions.getProgramBinary(program, length, &written, &format, binary.data());
+        if (written <= 0)
+            return false;
+
+        ProgramCacheHeader header;
+        memset(&header, 0, sizeof(header));
+        header.magic = PROGRAM_CACHE_MAGIC;
+        header.version = PROGRAM_CACHE_VERSION;
+        header.key = key;
+        header.binaryFormat = format;
+        header.binarySize = (uint64_t)written;
+
+        string path = cachePath(key);
+        string temporaryPath = path + ".tmp";
+        {
+            ofstream out(temporaryPath, ios::binary | ios::trunc);
+            if (!out)
+                return false;
+            out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+            out.write(reinterpret_cast<const char *>(binary.data()), written);
+            if (!out)
+            {
+                out.close();
+                remove(temporaryPath.c_str());
+                return false;
+            }
+        }
+        if (rename(temporaryPath.c_str(), path.c_str()) != 0)
+        {
+            remove(temporaryPath.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    // cold (compiled from source) against cached program build times of this run. the times are what the building
+    // thread spent, the driver's background compiling during a ShaderBatch isn't in them
+    static void report()
+    {
+        std::cout << "PROGRAM_CACHE:: " << programCacheStats.compiled << " programs compiled in "
+                  << programCacheStats.compileMilliseconds << " ms, " << programCacheStats.loaded
+                  << " loaded from the cache in " << programCacheStats.loadMilliseconds << " ms";
+        if (programCacheStats.rejected)
+            std::cout << ", " << programCacheStats.rejected << " cached binaries rejected by the driver";
+        if (!enabled())
+            std::cout << " (no program binary support)";
+        std::cout << std::endl;
+    }
+};
+
+#endif
@@ -0,0 +1,380 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/gl_state.h>
+#include <learnopengl/material.h>
+#include <learnopengl/mesh.h>
+#include <learnopengl/model.h>
+#include <learnopengl/shader.h>
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+// passes run in this order, every draw of one before any draw of the next
+enum class RenderPass : uint8_t {
+    Opaque = 0,
+    Sky = 1,        // at the far plane behind everything opaque, see RENDER_PASS_DEPTH_FUNCS
+};
+const unsigned int RENDER_PASS_COUNT = 2;
+// depth test of each pass; GL_LESS is what main sets up and what execute() leaves behind
+const GLenum RENDER_PASS_DEPTH_FUNCS[RENDER_PASS_COUNT] = {GL_LESS, GL_LEQUAL};
+
+// fields of a sort key, most significant first. program, material and geometry are slots RenderQueue hands out
+// the first time it sees one, so they stay small; slots past a field's range share its last value, which only
+// costs state changes.
+const unsigned int RENDER_KEY_PASS_BITS = 4;
+const unsigned int RENDER_KEY_PROGRAM_BITS = 10;
+const unsigned int RENDER_KEY_MATERIAL_BITS = 16;
+const unsigned int RENDER_KEY_GEOMETRY_BITS = 10;
+const unsigned int RENDER_KEY_DEPTH_BITS = 24;
+const unsigned int RENDER_KEY_GEOMETRY_SHIFT = RENDER_KEY_DEPTH_BITS;
+const unsigned int RENDER_KEY_MATERIAL_SHIFT = RENDER_KEY_GEOMETRY_SHIFT + RENDER_KEY_GEOMETRY_BITS;
+const unsigned int RENDER_KEY_PROGRAM_SHIFT = RENDER_KEY_MATERIAL_SHIFT + RENDER_KEY_MATERIAL_BITS;
+const unsigned int RENDER_KEY_PASS_SHIFT = RENDER_KEY_PROGRAM_SHIFT + RENDER_KEY_PROGRAM_BITS;
+static_assert(RENDER_KEY_PASS_SHIFT + RENDER_KEY_PASS_BITS == 64, "the sort key fields have to fill 64 bits");
+
+// a submitted draw as it is sorted: the key and where its command is
+struct RenderRecord {
+    uint64_t key;
+    uint32_t command;
+};
+
+// what a draw does once its turn comes
+struct RenderCommand {
+    enum Kind : uint8_t {
+        MeshDraw,           // mesh->Draw
+        ModelIndirect,      // model->DrawIndirect
+        ModelInstanced,     // model->DrawInstanced of the transforms [first, first + count)
+        ModelIndirectInstanced, // model->DrawIndirect of the transforms [first, first + count)
+        Arrays,             // glDrawArrays of vertexArray with material bound
+    };
+    Kind kind;
+    uint32_t program;       // slot in RenderQueue::programs
+    Mesh *mesh;
+    Model *model;
+    const Material *material;
+    GLuint vertexArray;
+    GLenum mode;
+    GLint first;
+    GLsizei count;
+    glm::mat4 transform;    // goes to the program's "model" uniform
+};
+
+// draws submitted in any order during a frame and executed sorted by (pass, program, material, geometry, depth),
+// so draws sharing a program, then a material, then a vertex array run back to back and each of those is bound once
+// per run instead of once per draw. within a run opaque draws go front to back for early depth rejection.
+class RenderQueue
+{
+public:
+    RenderQueue() = default;
+    RenderQueue(const RenderQueue &) = delete;
+    RenderQueue &operator=(const RenderQueue &) = delete;
+
+    // starts a frame; depth is the view space distance of a draw's origin, quantized over [nearPlane, farPlane]
+    void begin(const glm::mat4 &view, float nearPlane, float farPlane)
+    {
+        this->view = view;
+        this->nearPlane = nearPlane;
+        this->farPlane = farPlane;
+        records.clear();
+        commands.clear();
+        copyTransforms.clear();
+    }
+
+    // one mesh, with its own material and vertex array
+    void submit(Mesh &mesh, Shader &shader, const glm::mat4 &transform, RenderPass pass = RenderPass::Opaque)
+    {
+        RenderCommand &command = addCommand(RenderCommand::MeshDraw, shader, transform);
+        command.mesh = &mesh;
+        command.material = mesh.material;
+        push(pass, command, geometrySlot(meshVertexArray(mesh)), glm::vec3(transform[3]));
+    }
+
+    // every mesh of the model on its own, so they sort among the meshes of other models
+    void submit(Model &model, Shader &shader, const glm::mat4 &transform, RenderPass pass = RenderPass::Opaque)
+    {
+        for (Mesh &mesh : model.meshes)
+            submit(mesh, shader, transform, pass);
+    }
+
+    // the whole model with Model::DrawIndirect, keyed by the material and vertex array of its first mesh
+    void submitIndirect(Model &model, Shader &shader, const glm::mat4 &transform, RenderPass pass = RenderPass::Opaque)
+    {
+        if (model.meshes.empty())
+            return;
+        RenderCommand &command = addCommand(RenderCommand::ModelIndirect, shader, transform);
+        command.model = &model;
+        command.material = model.meshes[0].material;
+        push(pass, command, geometrySlot(meshVertexArray(model.meshes[0])), glm::vec3(transform[3]));
+    }
+
+    // a copy of the model per transform, all in one Model::DrawInstanced. the transforms place the copies on their
+    // own, "model" is identity for them; sorted as one draw at the average origin of the copies. the transforms are
+    // copied, they don't have to outlive the call
+    void submitInstanced(Model &model, Shader &shader, const glm::mat4 *transforms, unsigned int count,
+                         RenderPass pass = RenderPass::Opaque)
+    {
+        submitCopies(RenderCommand::ModelInstanced, model, shader, transforms, count, pass);
+    }
+    void submitInstanced(Model &model, Shader &shader, const vector<glm::mat4> &transforms,
+                         RenderPass pass = RenderPass::Opaque)
+    {
+        submitInstanced(model, shader, transforms.data(), (unsigned int)transforms.size(), pass);
+    }
+
+    // submitInstanced with Model::DrawIndirect, as many calls for all copies as for one
+    void submitIndirectInstanced(Model &model, Shader &shader, const glm::mat4 *transforms, unsigned int count,
+                                 RenderPass pass = RenderPass::Opaque)
+    {
+        submitCopies(RenderCommand::ModelIndirectInstanced, model, shader, transforms, count, pass);
+    }
+    void submitIndirectInstanced(Model &model, Shader &shader, const vector<glm::mat4> &transforms,
+                                 RenderPass pass = RenderPass::Opaque)
+    {
+        submitIndirectInstanced(model, shader, transforms.data(), (unsigned int)transforms.size(), pass);
+    }
+
+    // geometry that isn't a Mesh. material may be null; its samplers are only set where the shader uses the
+    // MATERIAL_TEXTURE_TYPES names, others keep the units main pointed them at
+    void submitArrays(Shader &shader, const Material *material, GLuint vertexArray, GLenum mode, GLint first,
+                      GLsizei count, const glm::mat4 &transform, RenderPass pass = RenderPass::Opaque)
+    {
+        RenderCommand &command = addCommand(RenderCommand::Arrays, shader, transform);
+        command.material = material;
+        command.vertexArray = vertexArray;
+        command.mode = mode;
+        command.first = first;
+        command.count = count;
+        push(pass, command, geometrySlot(vertexArray), glm::vec3(transform[3]));
+    }
+
+    // sorts the frame's draws and runs them; programs, materials and vertex arrays are only bound when they change
+    void execute()
+    {
+        sortRecords();
+        unsigned int pass = UINT_MAX;
+        uint32_t program = UINT32_MAX;
+        MaterialBindState material;
+        for (const RenderRecord &record : records)
+        {
+            const RenderCommand &command = commands[record.command];
+            unsigned int recordPass = (unsigned int)(record.key >> RENDER_KEY_PASS_SHIFT);
+            if (recordPass != pass)
+            {
+                glState.depthFunc(RENDER_PASS_DEPTH_FUNCS[recordPass]);
+                pass = recordPass;
+            }
+
+            RenderProgram &slot = *programs[command.program];
+            if (command.program != program)
+            {
+                slot.shader->use();
+                program = command.program;
+                // the material uniforms of this program are whatever it drew last
+                material.material = nullptr;
+            }
+            slot.model.set(command.transform);
+
+            switch (command.kind)
+            {
+            case RenderCommand::MeshDraw:
+            {
+                MeshDrawState state(slot.meshUniforms);
+                state.material = material;
+                command.mesh->Draw(*slot.shader, state);
+                material = state.material;
+                break;
+            }
+            case RenderCommand::ModelIndirect:
+                // DrawIndirect binds materials through uniform handles of its own
+                command.model->DrawIndirect(*slot.shader);
+                material.material = nullptr;
+                break;
+            case RenderCommand::ModelInstanced:
+                command.model->DrawInstanced(*slot.shader, &copyTransforms[command.first], command.count);
+                material.material = nullptr;
+                break;
+            case RenderCommand::ModelIndirectInstanced:
+                command.model->DrawIndirect(*slot.shader, &copyTransforms[command.first], command.count);
+                material.material = nullptr;
+                break;
+            case RenderCommand::Arrays:
+                slot.meshUniforms.resolve(*slot.shader, string());
+                if (command.material)
+                    command.material->bind(slot.meshUniforms.material, material);
+                glState.bindVertexArray(command.vertexArray);
+                glDrawArrays(command.mode, command.first, command.count);
+                break;
+            }
+        }
+        material.restore();
+        glState.depthFunc(RENDER_PASS_DEPTH_FUNCS[0]);
+    }
+
+    size_t size() const { return records.size(); }
+
+private:
+    // a shader draws have been submitted with, and the handles its draws set
+    struct RenderProgram {
+        Shader *shader = nullptr;
+        GLuint id = 0;
+        MeshUniforms meshUniforms;
+        Uniform<glm::mat4> model;
+    };
+
+    vector<unique_ptr<RenderProgram>> programs;
+    unordered_map<const Shader *, uint32_t> programSlots;
+    unordered_map<const Material *, uint32_t> materialSlots;
+    unordered_map<GLuint, uint32_t> geometrySlots;
+
+    vector<RenderRecord> records;
+    vector<RenderRecord> sortScratch;
+    vector<RenderCommand> commands;
+    // transforms of the copies of instanced submissions
+    vector<glm::mat4> copyTransforms;
+
+    glm::mat4 view = glm::mat4(1.0f);
+    float nearPlane = 0.1f;
+    float farPlane = 100.0f;
+
+    static GLuint meshVertexArray(const Mesh &mesh)
+    {
+        return mesh.arena ? mesh.arena->vertexArray(mesh.allocation) : mesh.VAO;
+    }
+
+    uint32_t programSlot(Shader &shader)
+    {
+        auto found = programSlots.find(&shader);
+        uint32_t slot;
+        if (found == programSlots.end())
+        {
+            slot = (uint32_t)programs.size();
+            programs.emplace_back(new RenderProgram());
+            programs[slot]->shader = &shader;
+            programSlots[&shader] = slot;
+        }
+        else
+            slot = found->second;
+        RenderProgram &program = *programs[slot];
+        // resolved again if the shader was rebuilt into another program object
+        if (program.id != shader.ID)
+        {
+            program.id = shader.ID;
+            program.model = shader.uniform<glm::mat4>("model");
+        }
+        return slot;
+    }
+
+    uint32_t materialSlot(const Material *material)
+    {
+        // slot 0 is no material
+        if (!material)
+            return 0;
+        auto inserted = materialSlots.emplace(material, (uint32_t)materialSlots.size() + 1);
+        return inserted.first->second;
+    }
+
+    uint32_t geometrySlot(GLuint vertexArray)
+    {
+        auto inserted = geometrySlots.emplace(vertexArray, (uint32_t)geometrySlots.size());
+        return inserted.first->second;
+    }
+
+    static uint64_t field(uint32_t value, unsigned int bits, unsigned int shift)
+    {
+        uint64_t mask = (1ull << bits) - 1;
+        return min((uint64_t)value, mask) << shift;
+    }
+
+    RenderCommand &addCommand(RenderCommand::Kind kind, Shader &shader, const glm::mat4 &transform)
+    {
+        commands.emplace_back();
+        RenderCommand &command = commands.back();
+        command.kind = kind;
+        command.program = programSlot(shader);
+        command.mesh = nullptr;
+        command.model = nullptr;
+        command.material = nullptr;
+        command.vertexArray = 0;
+        command.mode = GL_TRIANGLES;
+        command.first = 0;
+        command.count = 0;
+        command.transform = transform;
+        return command;
+    }
+
+    void submitCopies(RenderCommand::Kind kind, Model &model, Shader &shader, const glm::mat4 *transforms,
+                      unsigned int count, RenderPass pass)
+    {
+        if (model.meshes.empty() || count == 0)
+            return;
+        RenderCommand &command = addCommand(kind, shader, glm::mat4(1.0f));
+        command.model = &model;
+        command.material = model.meshes[0].material;
+        command.first = (GLint)copyTransforms.size();
+        command.count = (GLsizei)count;
+        glm::vec3 origin(0.0f);
+        for (unsigned int i = 0; i < count; i++)
+        {
+            copyTransforms.push_back(transforms[i]);
+            origin += glm::vec3(transforms[i][3]);
+        }
+        push(pass, command, geometrySlot(meshVertexArray(model.meshes[0])), origin / (float)count);
+    }
+
+    // origin is where the draw is in the world, its depth orders the draws of a run
+    void push(RenderPass pass, const RenderCommand &command, uint32_t geometry, const glm::vec3 &origin)
+    {
+        float distance = -(view * glm::vec4(origin, 1.0f)).z;
+        float depth = (distance - nearPlane) / (farPlane - nearPlane);
+        depth = min(max(depth, 0.0f), 1.0f);
+        const uint32_t depthMax = (1u << RENDER_KEY_DEPTH_BITS) - 1;
+
+        RenderRecord record;
+        record.key = field((uint32_t)pass, RENDER_KEY_PASS_BITS, RENDER_KEY_PASS_SHIFT) |
+                     field(command.program, RENDER_KEY_PROGRAM_BITS, RENDER_KEY_PROGRAM_SHIFT) |
+                     field(materialSlot(command.material), RENDER_KEY_MATERIAL_BITS, RENDER_KEY_MATERIAL_SHIFT) |
+                     field(geometry, RENDER_KEY_GEOMETRY_BITS, RENDER_KEY_GEOMETRY_SHIFT) |
+                     (uint64_t)(depth * depthMax);
+        record.command = (uint32_t)(commands.size() - 1);
+        records.push_back(record);
+    }
+
+    // least significant digit radix sort over the key bytes. stable, so draws with equal keys keep the order they
+    // were submitted in; bytes all keys share (the high program bits, say) are skipped
+    void sortRecords()
+    {
+        if (records.size() < 2)
+            return;
+        sortScratch.resize(records.size());
+        for (unsigned int shift = 0; shift < 64; shift += 8)
+        {
+            size_t counts[256] = {};
+            for (const RenderRecord &record : records)
+                counts[(record.key >> shift) & 0xff]++;
+            if (counts[(records[0].key >> shift) & 0xff] == records.size())
+                continue;
+            size_t offset = 0;
+            for (size_t &count : counts)
+            {
+                size_t bucket = count;
+                count = offset;
+                offset += bucket;
+            }
+            for (const RenderRecord &record : records)
+                sortScratch[counts[(record.key >> shift) & 0xff]++] = record;
+            records.swap(sortScratch);
+        }
+    }
+};
+
+#endif
@@ -4,174 +4,383 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <string>
 #include <fstream>
 #include <sstream>
+#include <thread>
 #include <iostream>
+#include <vector>
 #include <common.h>
+
+#include <learnopengl/gl_state.h>
+#include <learnopengl/program_cache.h>
+
+// uniform blocks shared by every program, see frame_uniforms.h. GLSL 3.30 can't give a block its binding point,
+// so Shader binds blocks with these names after linking.
+const GLuint FRAME_UNIFORM_BINDING = 0;
+const GLuint LIGHTING_UNIFORM_BINDING = 1;
+struct SharedUniformBlock {
+    const char *name;
+    GLuint binding;
+};
+const SharedUniformBlock SHARED_UNIFORM_BLOCKS[] = {
+    {"Frame", FRAME_UNIFORM_BINDING},
+    {"Lighting", LIGHTING_UNIFORM_BINDING},
+};
+
+// an active uniform of a linked program, found by Shader::reflectUniforms. value is a shadow copy of what was last
+// uploaded, so setting the same value again doesn't reach the driver.
+struct UniformSlot {
+    std::string name;
+    GLint location = -1;
+    GLenum type = 0;
+    bool known = false;             // value holds what the program has
+    unsigned char value[sizeof(float) * 16] = {};
+};
+
+// typed handle of a uniform, resolved once with Shader::uniform. setting it compares against the shadow copy and
+// calls glUniform* only when the value changed; the shader has to be in use, like for the set* functions.
+// handles of uniforms the program doesn't have (or that the compiler removed) are valid and do nothing.
+template <typename T>
+class Uniform
+{
+public:
+    Uniform() = default;
+    explicit Uniform(UniformSlot *slot) : slot(slot) {}
+
+    void set(const T &value) const
+    {
+        if (!slot || (slot->known && memcmp(slot->value, &value, sizeof(T)) == 0))
+            return;
+        // cleared first: a bool and an int set on the same uniform have to compare equal when they mean the same
+        memset(slot->value, 0, sizeof(slot->value));
+        memcpy(slot->value, &value, sizeof(T));
+        slot->known = true;
+        upload(slot->location, value);
+    }
+
+    bool valid() const { return slot != nullptr; }
+
+private:
+    UniformSlot *slot = nullptr;
+
+    static void upload(GLint location, bool value) { glUniform1i(location, (int)value); }
+    static void upload(GLint location, int value) { glUniform1i(location, value); }
+    static void upload(GLint location, float value) { glUniform1f(location, value); }
+    static void upload(GLint location, const glm::vec2 &value) { glUniform2fv(location, 1, &value[0]); }
+    static void upload(GLint location, const glm::vec3 &value) { glUniform3fv(location, 1, &value[0]); }
+    static void upload(GLint location, const glm::vec4 &value) { glUniform4fv(location, 1, &value[0]); }
+    static void upload(GLint location, const glm::ivec4 &value) { glUniform4iv(location, 1, &value[0]); }
+    static void upload(GLint location, const glm::mat2 &value) { glUniformMatrix2fv(location, 1, GL_FALSE, &value[0][0]); }
+    static void upload(GLint location, const glm::mat3 &value) { glUniformMatrix3fv(location, 1, GL_FALSE, &value[0][0]); }
+    static void upload(GLint location, const glm::mat4 &value) { glUniformMatrix4fv(location, 1, GL_FALSE, &value[0][0]); }
+};
+
+// GLSL types a Uniform<T> may point at; samplers are set through int handles
+inline bool UniformTypeMatches(GLenum type, bool) { return type == GL_BOOL || type == GL_INT; }
+inline bool UniformTypeMatches(GLenum type, int)
+{
+    return type == GL_INT || type == GL_BOOL || type == GL_SAMPLER_2D || type == GL_SAMPLER_2D_ARRAY ||
+           type == GL_SAMPLER_CUBE || type == GL_SAMPLER_3D || type == GL_SAMPLER_2D_SHADOW;
+}
+inline bool UniformTypeMatches(GLenum type, float) { return type == GL_FLOAT; }
+inline bool UniformTypeMatches(GLenum type, const glm::vec2 &) { return type == GL_FLOAT_VEC2; }
+inline bool UniformTypeMatches(GLenum type, const glm::vec3 &) { return type == GL_FLOAT_VEC3; }
+inline bool UniformTypeMatches(GLenum type, const glm::vec4 &) { return type == GL_FLOAT_VEC4; }
+inline bool UniformTypeMatches(GLenum type, const glm::ivec4 &) { return type == GL_INT_VEC4; }
+inline bool UniformTypeMatches(GLenum type, const glm::mat2 &) { return type == GL_FLOAT_MAT2; }
+inline bool UniformTypeMatches(GLenum type, const glm::mat3 &) { return type == GL_FLOAT_MAT3; }
+inline bool UniformTypeMatches(GLenum type, const glm::mat4 &) { return type == GL_FLOAT_MAT4; }
+
+// reads a shader file for glShaderSource: #include "file" lines (relative to the including file) are replaced by
+// the file, each file pasted once, and every entry of defines gets a #define line after #version. #line directives
+// keep compile errors pointing at the right line, the file number is the order the files were read in.
+// throws std::ifstream::failure when a file can't be read.
+inline std::string LoadShaderSource(const std::string &path, const std::vector<std::string> &defines);
+
+class ShaderBatch;
+
 class Shader
 {
 public:
     unsigned int ID;
     // constructor generates the shader on the fly
     // ------------------------------------------------------------------------
-    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
+    // defines become #define lines ahead of the code of every stage, see ShaderVariants
+    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr,
+           const std::vector<std::string> &defines = {})
     {
-        std::string vertexPathString(vertexPath);
-        std::string fragmentPathString(fragmentPath);
+        submit(vertexPath, fragmentPath, geometryPath, defines);
+        finishBuild();
+    }
+    // only submits the program to be compiled and linked: the shader can't be used before batch.finish()
+    Shader(ShaderBatch &batch, const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr,
+           const std::vector<std::string> &defines = {});
 
-        vertexPath = vertexPathString.c_str();
-        fragmentPath= fragmentPathString.c_str();
-        // 1. retrieve the vertex/fragment source code from filePath
-        std::string vertexCode;
-        std::string fragmentCode;
-        std::string geometryCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
-        std::ifstream gShaderFile;
-        // ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        gShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        try 
-        {
-            // open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
-            // read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();		
-            // close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
-            // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();			
-            // if geometry shader path is present, also load a geometry shader
-            if(geometryPath != nullptr)
-            {
-                std::string geometryPathString(geometryPath);
-                geometryPath = geometryPathString.c_str();
-                gShaderFile.open(geometryPath);
-                std::stringstream gShaderStream;
-                gShaderStream << gShaderFile.rdbuf();
-                gShaderFile.close();
-                geometryCode = gShaderStream.str();
-            }
-        }
-        catch (std::ifstream::failure& e)
-        {
-            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
-        }
-        const char* vShaderCode = vertexCode.c_str();
-        const char * fShaderCode = fragmentCode.c_str();
-        // 2. compile shaders
-        unsigned int vertex, fragment;
-        // vertex shader
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
-        // fragment Shader
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
-        // if geometry shader is given, compile geometry shader
-        unsigned int geometry;
-        if(geometryPath != nullptr)
+    // handles point into the uniform table
+    Shader(const Shader &) = delete;
+    Shader &operator=(const Shader &) = delete;
+    // activate the shader
+    // ------------------------------------------------------------------------
+    void use()
+    {
+        glState.useProgram(ID);
+    }
+    // typed handle of the uniform called name (array elements as "name[i]"), resolved once and kept for the sets
+    // that happen every frame. an invalid handle when the program has no such active uniform.
+    template <typename T>
+    Uniform<T> uniform(const char *name) const
+    {
+        UniformSlot *slot = findUniform(name);
+        if (slot && !UniformTypeMatches(slot->type, T()))
         {
-            const char * gShaderCode = geometryCode.c_str();
-            geometry = glCreateShader(GL_GEOMETRY_SHADER);
-            glShaderSource(geometry, 1, &gShaderCode, NULL);
-            glCompileShader(geometry);
-            checkCompileErrors(geometry, "GEOMETRY");
+            std::cout << "ERROR::SHADER::UNIFORM_TYPE_MISMATCH " << name << std::endl;
+            return Uniform<T>();
         }
-        // shader Program
-        ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
-        if(geometryPath != nullptr)
-            glAttachShader(ID, geometry);
-        glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
-        // delete the shaders as they're linked into our program now and no longer necessery
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
-        if(geometryPath != nullptr)
-            glDeleteShader(geometry);
-
+        return Uniform<T>(slot);
     }
-    // activate the shader
-    // ------------------------------------------------------------------------
-    void use() 
-    { 
-        glUseProgram(ID); 
+    template <typename T>
+    Uniform<T> uniform(const std::string &name) const
+    {
+        return uniform<T>(name.c_str());
     }
-    // utility uniform functions
+    // utility uniform functions, they look the uniform up on every call
     // ------------------------------------------------------------------------
     void setBool(const std::string &name, bool value) const
-    {         
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+    {
+        uniform<bool>(name).set(value);
     }
     // ------------------------------------------------------------------------
     void setInt(const std::string &name, int value) const
-    { 
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+    {
+        uniform<int>(name).set(value);
     }
     // ------------------------------------------------------------------------
     void setFloat(const std::string &name, float value) const
-    { 
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+    {
+        uniform<float>(name).set(value);
     }
     // ------------------------------------------------------------------------
     void setVec2(const std::string &name, const glm::vec2 &value) const
-    { 
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+    {
+        uniform<glm::vec2>(name).set(value);
     }
     void setVec2(const std::string &name, float x, float y) const
-    { 
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); 
+    {
+        uniform<glm::vec2>(name).set(glm::vec2(x, y));
     }
     // ------------------------------------------------------------------------
     void setVec3(const std::string &name, const glm::vec3 &value) const
-    { 
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+    {
+        uniform<glm::vec3>(name).set(value);
     }
     void setVec3(const std::string &name, float x, float y, float z) const
-    { 
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); 
+    {
+        uniform<glm::vec3>(name).set(glm::vec3(x, y, z));
     }
     // ------------------------------------------------------------------------
     void setVec4(const std::string &name, const glm::vec4 &value) const
-    { 
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+    {
+        uniform<glm::vec4>(name).set(value);
     }
-    void setVec4(const std::string &name, float x, float y, float z, float w) 
-    { 
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w); 
+    void setVec4(const std::string &name, float x, float y, float z, float w)
+    {
+        uniform<glm::vec4>(name).set(glm::vec4(x, y, z, w));
     }
     // ------------------------------------------------------------------------
     void setMat2(const std::string &name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        uniform<glm::mat2>(name).set(mat);
     }
     // ------------------------------------------------------------------------
     void setMat3(const std::string &name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        uniform<glm::mat3>(name).set(mat);
     }
     // ------------------------------------------------------------------------
     void setMat4(const std::string &name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        uniform<glm::mat4>(name).set(mat);
     }
 
 private:
+    // every active uniform of the program, filled once after linking. mutable so setting a uniform through a const
+    // Shader can update the shadow copies
+    mutable std::vector<UniformSlot> uniforms;
+
+    // lists the active uniforms with glGetActiveUniform, arrays with a slot per element
+    void reflectUniforms()
+    {
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<GLchar> name(maxLength > 0 ? maxLength : 1);
+        for (GLint i = 0; i < count; i++)
+        {
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(ID, (GLuint)i, (GLsizei)name.size(), nullptr, &size, &type, name.data());
+            std::string base = name.data();
+            bool array = base.size() > 3 && base.compare(base.size() - 3, 3, "[0]") == 0;
+            if (array)
+                base.erase(base.size() - 3);
+            for (GLint element = 0; element < size; element++)
+            {
+                UniformSlot slot;
+                slot.name = array ? base + '[' + std::to_string(element) + ']' : base;
+                slot.location = glGetUniformLocation(ID, slot.name.c_str());
+                slot.type = type;
+                // uniforms in uniform blocks have no location
+                if (slot.location >= 0)
+                    uniforms.push_back(slot);
+            }
+        }
+    }
+
+    void bindSharedUniformBlocks()
+    {
+        for (const SharedUniformBlock &block : SHARED_UNIFORM_BLOCKS)
+        {
+            GLuint index = glGetUniformBlockIndex(ID, block.name);
+            if (index != GL_INVALID_INDEX)
+                glUniformBlockBinding(ID, index, block.binding);
+        }
+    }
+
+    // GL accepts an array's name for its first element, so "name" also finds "name[0]"
+    UniformSlot *findUniform(const char *name) const
+    {
+        size_t length = strlen(name);
+        for (UniformSlot &slot : uniforms)
+        {
+            if (slot.name == name)
+                return &slot;
+            if (slot.name.size() == length + 3 && slot.name.compare(0, length, name) == 0 && slot.name.compare(length, 3, "[0]") == 0)
+                return &slot;
+        }
+        return nullptr;
+    }
+
+    friend class ShaderBatch;
+
+    // a build between submit() and finishBuild()
+    struct Build {
+        bool pending = false;
+        bool cached = false;
+        uint64_t cacheKey = 0;
+        GLuint stages[3] = {};      // vertex, fragment and geometry shader, kept for their logs
+        double milliseconds = 0.0;  // spent in this thread so far
+    };
+    Build build;
+
+    // 1. retrieve the source code with the files it includes, 2. load the linked program from the program cache, or
+    // start compiling and linking it. nothing asks the driver whether that worked, so it can go on in the background
+    void submit(const char* vertexPath, const char* fragmentPath, const char* geometryPath,
+                const std::vector<std::string> &defines)
+    {
+        std::string vertexCode;
+        std::string fragmentCode;
+        std::string geometryCode;
+        try 
+        {
+            vertexCode = LoadShaderSource(vertexPath, defines);
+            fragmentCode = LoadShaderSource(fragmentPath, defines);
+            // if geometry shader path is present, also load a geometry shader
+            if(geometryPath != nullptr)
+                geometryCode = LoadShaderSource(geometryPath, defines);
+        }
+        catch (std::ifstream::failure& e)
+        {
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        build.pending = true;
+        build.cacheKey = ProgramCache::key({vertexCode, fragmentCode, geometryCode});
+        ID = glCreateProgram();
+        build.cached = ProgramCache::load(build.cacheKey, ID);
+        if (!build.cached)
+        {
+            // a program that failed to load a binary is in no state to be reused
+            glState.deleteProgram(ID);
+            ID = glCreateProgram();
+            const std::string *codes[3] = {&vertexCode, &fragmentCode, &geometryCode};
+            const GLenum types[3] = {GL_VERTEX_SHADER, GL_FRAGMENT_SHADER, GL_GEOMETRY_SHADER};
+            for (int stage = 0; stage < 3; stage++)
+            {
+                // no geometry shader when there is no geometry code
+                if (codes[stage]->empty())
+                    continue;
+                const char *code = codes[stage]->c_str();
+                build.stages[stage] = glCreateShader(types[stage]);
+                glShaderSource(build.stages[stage], 1, &code, NULL);
+                glCompileShader(build.stages[stage]);
+                glAttachShader(ID, build.stages[stage]);
+            }
+            ProgramCache::prepare(ID);
+            glLinkProgram(ID);
+        }
+        build.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // whether finishBuild() would return without waiting. only the parallel shader compile extension can tell,
+    // without it this is always true
+    bool buildComplete() const
+    {
+        if (!build.pending || build.cached || !glExtensions.parallelShaderCompile)
+            return true;
+        GLint complete = GL_FALSE;
+        glGetProgramiv(ID, GL_COMPLETION_STATUS_KHR, &complete);
+        return complete == GL_TRUE;
+    }
+
+    // waits for the program, reports compile errors, caches the binary and reflects the uniforms
+    void finishBuild()
+    {
+        if (!build.pending)
+            return;
+        build.pending = false;
+        auto start = std::chrono::steady_clock::now();
+        if (!build.cached)
+        {
+            const char *stageNames[3] = {"VERTEX", "FRAGMENT", "GEOMETRY"};
+            for (int stage = 0; stage < 3; stage++)
+                if (build.stages[stage])
+                    checkCompileErrors(build.stages[stage], stageNames[stage]);
+            bool linked = checkCompileErrors(ID, "PROGRAM");
+            // delete the shaders as they're linked into our program now and no longer necessery
+            for (GLuint &stage : build.stages)
+            {
+                if (stage)
+                    glDeleteShader(stage);
+                stage = 0;
+            }
+            if (linked)
+                ProgramCache::store(build.cacheKey, ID);
+        }
+        reflectUniforms();
+        bindSharedUniformBlocks();
+
+        build.milliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (build.cached)
+        {
+            programCacheStats.loaded++;
+            programCacheStats.loadMilliseconds += build.milliseconds;
+        }
+        else
+        {
+            programCacheStats.compiled++;
+            programCacheStats.compileMilliseconds += build.milliseconds;
+        }
+    }
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
-    void checkCompileErrors(GLuint shader, std::string type)
+    // returns whether it succeeded
+    bool checkCompileErrors(GLuint shader, std::string type)
     {
         GLint success;
         GLchar infoLog[1024];
@@ -193,6 +402,119 @@ private:
                 std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
             }
         }
+        return success == GL_TRUE;
+    }
+};
+
+// programs built together: each one is submitted (compiled and linked without asking how it went) before any status
+// is read, so a driver that compiles on threads of its own works on all of them at once while this thread goes on
+// loading assets. with KHR_parallel_shader_compile poll() finishes whichever programs are done without blocking.
+class ShaderBatch
+{
+public:
+    ShaderBatch()
+    {
+        // let the driver pick how many threads to compile on
+        if (glExtensions.parallelShaderCompile)
+            glExtensions.maxShaderCompilerThreads(0xFFFFFFFF);
+    }
+
+    // finishes the programs that are done compiling, true once all are. without the extension it can't tell and
+    // blocks like finish()
+    bool poll()
+    {
+        for (size_t i = 0; i < pending.size(); )
+        {
+            if (pending[i]->buildComplete())
+            {
+                pending[i]->finishBuild();
+                pending.erase(pending.begin() + i);
+            }
+            else
+                i++;
+        }
+        return pending.empty();
+    }
+
+    // waits for every program of the batch
+    void finish()
+    {
+        while (!poll())
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
     }
+
+private:
+    friend class Shader;
+    std::vector<Shader *> pending;
 };
-#endif
+
+inline Shader::Shader(ShaderBatch &batch, const char* vertexPath, const char* fragmentPath, const char* geometryPath,
+                      const std::vector<std::string> &defines)
+{
+    submit(vertexPath, fragmentPath, geometryPath, defines);
+    batch.pending.push_back(this);
+}
+
+inline void AppendShaderFile(const std::string &path, std::vector<std::string> &files, std::string &source)
+{
+    std::ifstream file;
+    file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+    file.open(path);
+    std::stringstream stream;
+    stream << file.rdbuf();
+    file.close();
+
+    const std::string fileNumber = std::to_string(files.size());
+    files.push_back(path);
+    if (files.size() > 1)
+        source += "#line 1 " + fileNumber + "\n";
+    const std::string directory = path.substr(0, path.find_last_of('/') + 1);
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(stream, line))
+    {
+        lineNumber++;
+        size_t start = line.find_first_not_of(" \t");
+        bool directive = start != std::string::npos && line[start] == '#';
+        if (directive && line.compare(start, 8, "#include") == 0)
+        {
+            size_t open = line.find('"', start);
+            size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+            if (close == std::string::npos)
+            {
+                std::cout << "ERROR::SHADER::BAD_INCLUDE " << path << ":" << lineNumber << std::endl;
+                continue;
+            }
+            std::string included = directory + line.substr(open + 1, close - open - 1);
+            if (std::find(files.begin(), files.end(), included) == files.end())
+                AppendShaderFile(included, files, source);
+            source += "#line " + std::to_string(lineNumber + 1) + " " + fileNumber + "\n";
+            continue;
+        }
+        source += line;
+        source += '\n';
+    }
+}
+
+inline std::string LoadShaderSource(const std::string &path, const std::vector<std::string> &defines)
+{
+    std::vector<std::string> files;
+    std::string source;
+    AppendShaderFile(path, files, source);
+    if (defines.empty())
+        return source;
+
+    // the defines go after #version, which has to come first
+    size_t versionEnd = 0;
+    size_t start = source.find_first_not_of(" \t\r\n");
+    if (start != std::string::npos && source.compare(start, 8, "#version") == 0)
+        versionEnd = source.find('\n', start) + 1;
+    long line = 1 + std::count(source.begin(), source.begin() + versionEnd, '\n');
+    std::string block;
+    for (const std::string &define : defines)
+        block += "#define " + define + "\n";
+    block += "#line " + std::to_string(line) + " 0\n";
+    return source.insert(versionEnd, block);
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,96 @@
+#ifndef SHADER_VARIANTS_H
+#define SHADER_VARIANTS_H
+
+#include <learnopengl/shader.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+using namespace std;
+
+template <typename T>
+class VariantUniform;
+
+// one shader compiled for every combination of a few feature keys. a variant's keys are #defined ahead of the
+// source, so the shader branches with #ifdef at compile time and each variant runs only the code of its
+// configuration. variants are numbered by a bit mask: bit i set means keys[i] is defined.
+class ShaderVariants
+{
+public:
+    ShaderVariants(const char *vertexPath, const char *fragmentPath, const vector<string> &keys)
+    {
+        create(nullptr, vertexPath, fragmentPath, keys);
+    }
+    // only submits the variants, they can be used after batch.finish()
+    ShaderVariants(ShaderBatch &batch, const char *vertexPath, const char *fragmentPath, const vector<string> &keys)
+    {
+        create(&batch, vertexPath, fragmentPath, keys);
+    }
+
+    ShaderVariants(const ShaderVariants &) = delete;
+    ShaderVariants &operator=(const ShaderVariants &) = delete;
+
+    // makes the variant current and activates it; VariantUniform sets go to the current variant
+    Shader &use(unsigned int mask)
+    {
+        current = mask;
+        variants[mask]->use();
+        return *variants[mask];
+    }
+
+    Shader &variant(unsigned int mask) const { return *variants[mask]; }
+    unsigned int currentMask() const { return current; }
+    unsigned int count() const { return (unsigned int)variants.size(); }
+
+    // the uniform resolved in every variant, see Shader::uniform
+    template <typename T>
+    VariantUniform<T> uniform(const char *name) const;
+
+private:
+    vector<unique_ptr<Shader>> variants;
+    unsigned int current = 0;
+
+    void create(ShaderBatch *batch, const char *vertexPath, const char *fragmentPath, const vector<string> &keys)
+    {
+        for (unsigned int mask = 0; mask < (1u << keys.size()); mask++)
+        {
+            vector<string> defines;
+            for (size_t key = 0; key < keys.size(); key++)
+                if (mask & (1u << key))
+                    defines.push_back(keys[key]);
+            if (batch)
+                variants.emplace_back(new Shader(*batch, vertexPath, fragmentPath, nullptr, defines));
+            else
+                variants.emplace_back(new Shader(vertexPath, fragmentPath, nullptr, defines));
+        }
+    }
+};
+
+// a Uniform in each variant of a ShaderVariants, setting it sets the one of the current variant
+template <typename T>
+class VariantUniform
+{
+public:
+    VariantUniform(const ShaderVariants &variants, vector<Uniform<T>> handles)
+        : variants(&variants), handles(move(handles)) {}
+
+    void set(const T &value) const
+    {
+        handles[variants->currentMask()].set(value);
+    }
+
+private:
+    const ShaderVariants *variants;
+    vector<Uniform<T>> handles;
+};
+
+template <typename T>
+VariantUniform<T> ShaderVariants::uniform(const char *name) const
+{
+    vector<Uniform<T>> handles;
+    for (const unique_ptr<Shader> &shader : variants)
+        handles.push_back(shader->uniform<T>(name));
+    return VariantUniform<T>(*this, move(handles));
+}
+
+#endif
@@ -0,0 +1,201 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/gl_state.h>
+#include <learnopengl/mapped_file.h>
+#include <learnopengl/texture_streamer.h>
+
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+// process wide texture cache shared by model materials and the textures main loads itself.
+// a texture is keyed by everything that changes how it is stored and sampled plus the file's contents, so the same
+// image reached through different paths (or from different models) is decoded and uploaded once. contents are only
+// compared between files of the same size, see acquire().
+// acquire() hands out a reference, release() gives it back and deletes the texture when the last one is gone.
+class TextureCache
+{
+public:
+    explicit TextureCache(TextureStreamer &streamer) : streamer(streamer) {}
+
+    TextureCache(const TextureCache &) = delete;
+    TextureCache &operator=(const TextureCache &) = delete;
+
+    unsigned int acquire(const string &path, const TextureSettings &settings)
+    {
+        requests++;
+        // paths seen before skip hashing the file, which is the slow part for 4K images
+        string sampling = samplingKey(settings);
+        string pathKey = sampling + canonicalPath(path);
+        auto known = keysByPath.find(pathKey);
+        if (known != keysByPath.end())
+            return reuse(known->second);
+
+        // only a file as large as a loaded texture's can have the same contents, so only then is it hashed here (and
+        // the textures of that size with it). any other file is keyed by its path and hashed once, by the worker
+        // loading it. unreadable files have no size and are keyed by path too, they still share a placeholder
+        size_t fileSize = FileSize(path);
+        uint64_t contentHash = 0;
+        for (auto &candidate : entries)
+        {
+            Entry &entry = candidate.second;
+            if (fileSize == 0 || entry.fileSize != fileSize || entry.sampling != sampling)
+                continue;
+            if (!contentHash)
+                contentHash = CookedTextureCache::sourceHash(path);
+            if (contentHash && contentHash == entryHash(entry))
+            {
+                keysByPath[pathKey] = entry.key;
+                return reuse(entry.key);
+            }
+        }
+        string key = contentHash ? sampling + hashString(contentHash) : pathKey;
+        keysByPath[pathKey] = key;
+
+        Entry entry;
+        entry.id = streamer.load(path, settings, contentHash);
+        entry.key = key;
+        entry.references = 1;
+        entry.sampling = sampling;
+        entry.path = path;
+        entry.fileSize = fileSize;
+        entry.contentHash = contentHash;
+        keysById[entry.id] = key;
+        entries[key] = entry;
+        return entry.id;
+    }
+
+    // texture array with the images at paths as its layers (see TextureStreamer::loadArray), shared by every request
+    // for the same images in the same order and given back with release() like any other texture. like acquire(),
+    // a layer list seen before is found by its paths; the layers are only hashed for a new one
+    unsigned int acquireArray(const vector<string> &paths, const TextureSettings &settings)
+    {
+        requests++;
+        string pathKey = samplingKey(settings) + "array";
+        for (const string &path : paths)
+            pathKey += ':' + canonicalPath(path);
+        auto known = keysByPath.find(pathKey);
+        if (known != keysByPath.end())
+            return reuse(known->second);
+
+        string key = samplingKey(settings) + "array";
+        vector<uint64_t> contentHashes;
+        for (const string &path : paths)
+        {
+            uint64_t contentHash = CookedTextureCache::sourceHash(path);
+            contentHashes.push_back(contentHash);
+            key += ':' + (contentHash ? hashString(contentHash) : canonicalPath(path));
+        }
+        keysByPath[pathKey] = key;
+        if (entries.count(key))
+            return reuse(key);
+
+        Entry entry;
+        entry.id = streamer.loadArray(paths, settings, contentHashes);
+        entry.key = key;
+        entry.references = 1;
+        keysById[entry.id] = key;
+        entries[key] = entry;
+        return entry.id;
+    }
+
+    void release(unsigned int textureID)
+    {
+        auto key = keysById.find(textureID);
+        if (key == keysById.end())
+            return;
+        Entry &entry = entries[key->second];
+        if (--entry.references > 0)
+            return;
+        streamer.forget(entry.id);
+        glState.deleteTextures(1, &entry.id);
+        // drop the path aliases of the texture too, a later acquire must load it again
+        for (auto alias = keysByPath.begin(); alias != keysByPath.end(); )
+        {
+            if (alias->second == entry.key)
+                alias = keysByPath.erase(alias);
+            else
+                ++alias;
+        }
+        entries.erase(key->second);
+        keysById.erase(key);
+    }
+
+    size_t size() const { return entries.size(); }
+
+    void report() const
+    {
+        std::cout << "TEXTURE_CACHE:: " << requests << " texture requests, " << entries.size() << " unique textures, "
+                  << hits << " served from the cache" << std::endl;
+    }
+
+private:
+    struct Entry {
+        unsigned int id = 0;
+        unsigned int references = 0;
+        string key;
+        // what acquire() compares new files against; the hash stays 0 until something needs it
+        string sampling;
+        string path;
+        size_t fileSize = 0;
+        uint64_t contentHash = 0;
+    };
+
+    TextureStreamer &streamer;
+    unordered_map<string, Entry> entries;           // sampling key + content hash (or path) -> texture
+    unordered_map<string, string> keysByPath;       // sampling key + canonical path -> entry key
+    unordered_map<unsigned int, string> keysById;   // texture name -> entry key, for release()
+    unsigned int requests = 0;
+    unsigned int hits = 0;
+
+    unsigned int reuse(const string &key)
+    {
+        Entry &entry = entries[key];
+        entry.references++;
+        hits++;
+        return entry.id;
+    }
+
+    // content hash of a texture's file: the one the worker computed once the texture is uploaded, hashed here before
+    uint64_t entryHash(Entry &entry)
+    {
+        if (!entry.contentHash)
+            entry.contentHash = streamer.sourceHash(entry.id);
+        if (!entry.contentHash)
+            entry.contentHash = CookedTextureCache::sourceHash(entry.path);
+        return entry.contentHash;
+    }
+
+    // the placeholder colour only matters until the image arrives, it doesn't make two textures different
+    static string samplingKey(const TextureSettings &settings)
+    {
+        return to_string((int)settings.role) + ':' + to_string(settings.srgb) + to_string(settings.flipVertically)
+               + to_string(settings.clampIfAlpha) + ':' + to_string(settings.wrap) + ':';
+    }
+
+    static string canonicalPath(const string &path)
+    {
+        char resolved[PATH_MAX];
+        if (realpath(path.c_str(), resolved))
+            return resolved;
+        return path;
+    }
+
+    static string hashString(uint64_t hash)
+    {
+        char text[17];
+        snprintf(text, sizeof(text), "%016llx", (unsigned long long)hash);
+        return text;
+    }
+};
+
+#endif
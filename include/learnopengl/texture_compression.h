@@ -0,0 +1,364 @@
+#ifndef TEXTURE_COMPRESSION_H
+#define TEXTURE_COMPRESSION_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+using namespace std;
+
+// block compressed formats produced by the asset cooker. the values are stored in cooked texture files, don't renumber.
+enum class TextureCodec : uint32_t {
+    BC1 = 1,    // RGB, 4 bits per texel (S3TC DXT1)
+    BC3 = 3,    // RGBA, 8 bits per texel (S3TC DXT5)
+    BC4 = 4,    // one channel, 4 bits per texel (RGTC1), height maps
+    BC5 = 5,    // two channels, 8 bits per texel (RGTC2), x and y of normal maps
+};
+
+// what a texture is used for. the role decides how many channels the GPU keeps and whether they are sRGB,
+// independent of how many channels the image file happens to have. the values are stored in cooked texture files.
+enum class TextureRole {
+    Albedo,             // colour (+ alpha)
+    Normal,             // tangent space x and y, z is rebuilt in the shader
+    Height,             // parallax depth, kept at 16 bit when the source has it
+    Roughness,
+    AmbientOcclusion,
+    Specular,           // specular intensity, shaders read the first channel
+};
+
+// how texels are averaged when building the next mip level
+enum class MipFilter {
+    Linear,     // data textures, averaged as stored
+    Srgb,       // colour textures, averaged in linear light so mips don't darken
+    NormalMap,  // averaged as vectors and renormalized
+};
+
+// one compressed mip level
+struct CompressedLevel {
+    int width = 0;
+    int height = 0;
+    vector<unsigned char> data;
+};
+
+const char *TextureCodecName(TextureCodec codec);
+bool TextureCodecFitsRole(TextureCodec codec, TextureRole role);
+size_t CompressedSize(TextureCodec codec, int width, int height);
+vector<unsigned char> CompressImage(const unsigned char *rgba, int width, int height, TextureCodec codec);
+vector<unsigned char> DownsampleImage(const unsigned char *rgba, int width, int height, MipFilter filter);
+vector<CompressedLevel> CompressMipChain(vector<unsigned char> rgba, int width, int height, TextureCodec codec, MipFilter filter);
+void EncodeColorBlock(const unsigned char texels[16][4], unsigned char *out);
+void EncodeChannelBlock(const unsigned char values[16], unsigned char *out);
+
+const char *TextureCodecName(TextureCodec codec)
+{
+    switch (codec)
+    {
+    case TextureCodec::BC1: return "BC1";
+    case TextureCodec::BC3: return "BC3";
+    case TextureCodec::BC4: return "BC4";
+    case TextureCodec::BC5: return "BC5";
+    }
+    return "?";
+}
+
+// whether a texture of this role can be stored with codec: the channels it keeps must be the ones the role needs
+// (see ChooseTextureFormat), and the mips must have been built the way the role averages them
+bool TextureCodecFitsRole(TextureCodec codec, TextureRole role)
+{
+    switch (role)
+    {
+    case TextureRole::Albedo:
+        return codec == TextureCodec::BC1 || codec == TextureCodec::BC3;
+    case TextureRole::Normal:
+        return codec == TextureCodec::BC5;
+    case TextureRole::Height:
+    case TextureRole::Roughness:
+    case TextureRole::AmbientOcclusion:
+    case TextureRole::Specular:
+        return codec == TextureCodec::BC4;
+    }
+    return false;
+}
+
+size_t CompressedSize(TextureCodec codec, int width, int height)
+{
+    size_t blockBytes = codec == TextureCodec::BC1 || codec == TextureCodec::BC4 ? 8 : 16;
+    return (size_t)((width + 3) / 4) * ((height + 3) / 4) * blockBytes;
+}
+
+// compresses an RGBA8 image. images that aren't a multiple of 4 texels are padded by repeating the edge texels,
+// which the GPU never samples.
+vector<unsigned char> CompressImage(const unsigned char *rgba, int width, int height, TextureCodec codec)
+{
+    vector<unsigned char> out(CompressedSize(codec, width, height));
+    unsigned char *block = out.data();
+    for (int by = 0; by < height; by += 4)
+    {
+        for (int bx = 0; bx < width; bx += 4)
+        {
+            unsigned char texels[16][4];
+            for (int i = 0; i < 16; i++)
+            {
+                int x = min(bx + i % 4, width - 1);
+                int y = min(by + i / 4, height - 1);
+                const unsigned char *texel = rgba + ((size_t)y * width + x) * 4;
+                for (int c = 0; c < 4; c++)
+                    texels[i][c] = texel[c];
+            }
+
+            unsigned char channel[16];
+            switch (codec)
+            {
+            case TextureCodec::BC1:
+                EncodeColorBlock(texels, block);
+                block += 8;
+                break;
+            case TextureCodec::BC3:
+                for (int i = 0; i < 16; i++)
+                    channel[i] = texels[i][3];
+                EncodeChannelBlock(channel, block);
+                EncodeColorBlock(texels, block + 8);
+                block += 16;
+                break;
+            case TextureCodec::BC4:
+                for (int i = 0; i < 16; i++)
+                    channel[i] = texels[i][0];
+                EncodeChannelBlock(channel, block);
+                block += 8;
+                break;
+            case TextureCodec::BC5:
+                for (int c = 0; c < 2; c++)
+                {
+                    for (int i = 0; i < 16; i++)
+                        channel[i] = texels[i][c];
+                    EncodeChannelBlock(channel, block + c * 8);
+                }
+                block += 16;
+                break;
+            }
+        }
+    }
+    return out;
+}
+
+// halves an RGBA8 image with a 2x2 box filter; odd edges reuse the last row/column
+vector<unsigned char> DownsampleImage(const unsigned char *rgba, int width, int height, MipFilter filter)
+{
+    // built once, the cooker calls this from several threads
+    static const vector<float> toLinear = [] {
+        vector<float> table(256);
+        for (int i = 0; i < 256; i++)
+        {
+            float c = i / 255.0f;
+            table[i] = c <= 0.04045f ? c / 12.92f : pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+        return table;
+    }();
+
+    int outWidth = max(width / 2, 1), outHeight = max(height / 2, 1);
+    vector<unsigned char> out((size_t)outWidth * outHeight * 4);
+    for (int y = 0; y < outHeight; y++)
+    {
+        for (int x = 0; x < outWidth; x++)
+        {
+            const unsigned char *texels[4];
+            for (int i = 0; i < 4; i++)
+            {
+                int sx = min(x * 2 + i % 2, width - 1);
+                int sy = min(y * 2 + i / 2, height - 1);
+                texels[i] = rgba + ((size_t)sy * width + sx) * 4;
+            }
+
+            float sum[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+            for (int i = 0; i < 4; i++)
+            {
+                for (int c = 0; c < 4; c++)
+                {
+                    if (c < 3 && filter == MipFilter::Srgb)
+                        sum[c] += toLinear[texels[i][c]];
+                    else if (c < 3 && filter == MipFilter::NormalMap)
+                        sum[c] += texels[i][c] / 127.5f - 1.0f;
+                    else
+                        sum[c] += texels[i][c] / 255.0f;
+                }
+            }
+
+            float result[4];
+            for (int c = 0; c < 4; c++)
+                result[c] = sum[c] / 4.0f;
+            if (filter == MipFilter::Srgb)
+            {
+                for (int c = 0; c < 3; c++)
+                    result[c] = result[c] <= 0.0031308f ? result[c] * 12.92f : 1.055f * pow(result[c], 1.0f / 2.4f) - 0.055f;
+            }
+            else if (filter == MipFilter::NormalMap)
+            {
+                float length = sqrt(result[0] * result[0] + result[1] * result[1] + result[2] * result[2]);
+                for (int c = 0; c < 3; c++)
+                    result[c] = length > 0.0f ? (result[c] / length) * 0.5f + 0.5f : (c == 2 ? 1.0f : 0.5f);
+            }
+
+            unsigned char *texel = out.data() + ((size_t)y * outWidth + x) * 4;
+            for (int c = 0; c < 4; c++)
+                texel[c] = (unsigned char)(min(max(result[c], 0.0f), 1.0f) * 255.0f + 0.5f);
+        }
+    }
+    return out;
+}
+
+// compresses every level from the full image down to 1x1
+vector<CompressedLevel> CompressMipChain(vector<unsigned char> rgba, int width, int height, TextureCodec codec, MipFilter filter)
+{
+    vector<CompressedLevel> levels;
+    for (;;)
+    {
+        CompressedLevel level;
+        level.width = width;
+        level.height = height;
+        level.data = CompressImage(rgba.data(), width, height, codec);
+        levels.push_back(std::move(level));
+        if (width == 1 && height == 1)
+            return levels;
+        rgba = DownsampleImage(rgba.data(), width, height, filter);
+        width = max(width / 2, 1);
+        height = max(height / 2, 1);
+    }
+}
+
+// BC1 colour block: the endpoints are the extremes of the texels along their principal axis,
+// every texel then picks the closest of the four palette colours
+void EncodeColorBlock(const unsigned char texels[16][4], unsigned char *out)
+{
+    float mean[3] = {0.0f, 0.0f, 0.0f};
+    for (int i = 0; i < 16; i++)
+        for (int c = 0; c < 3; c++)
+            mean[c] += texels[i][c] / 16.0f;
+
+    float covariance[6] = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+    for (int i = 0; i < 16; i++)
+    {
+        float r = texels[i][0] - mean[0], g = texels[i][1] - mean[1], b = texels[i][2] - mean[2];
+        covariance[0] += r * r;
+        covariance[1] += r * g;
+        covariance[2] += r * b;
+        covariance[3] += g * g;
+        covariance[4] += g * b;
+        covariance[5] += b * b;
+    }
+    // power iteration, a handful of steps is plenty for a 3x3 matrix
+    float axis[3] = {1.0f, 1.0f, 1.0f};
+    for (int iteration = 0; iteration < 8; iteration++)
+    {
+        float next[3] = {
+            covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2],
+            covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2],
+            covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2],
+        };
+        float length = max(max(fabs(next[0]), fabs(next[1])), fabs(next[2]));
+        if (length < 1e-6f)
+            break;
+        for (int c = 0; c < 3; c++)
+            axis[c] = next[c] / length;
+    }
+
+    float minProjection = 0.0f, maxProjection = 0.0f;
+    for (int i = 0; i < 16; i++)
+    {
+        float projection = 0.0f;
+        for (int c = 0; c < 3; c++)
+            projection += (texels[i][c] - mean[c]) * axis[c];
+        minProjection = min(minProjection, projection);
+        maxProjection = max(maxProjection, projection);
+    }
+    float axisLength = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+
+    // quantize the endpoints to 5:6:5
+    uint16_t endpoints[2];
+    const int bits[3] = {5, 6, 5};
+    for (int e = 0; e < 2; e++)
+    {
+        float projection = (e == 0 ? maxProjection : minProjection) / axisLength;
+        uint16_t packed = 0;
+        for (int c = 0; c < 3; c++)
+        {
+            float value = min(max(mean[c] + axis[c] * projection, 0.0f), 255.0f);
+            int maximum = (1 << bits[c]) - 1;
+            packed = (uint16_t)((packed << bits[c]) | (int)(value * maximum / 255.0f + 0.5f));
+        }
+        endpoints[e] = packed;
+    }
+    // the first endpoint has to be the larger one, otherwise the block is decoded in three colour mode
+    if (endpoints[0] < endpoints[1])
+        swap(endpoints[0], endpoints[1]);
+
+    float palette[4][3];
+    for (int e = 0; e < 2; e++)
+    {
+        palette[e][0] = ((endpoints[e] >> 11) & 31) * 255.0f / 31.0f;
+        palette[e][1] = ((endpoints[e] >> 5) & 63) * 255.0f / 63.0f;
+        palette[e][2] = (endpoints[e] & 31) * 255.0f / 31.0f;
+    }
+    for (int c = 0; c < 3; c++)
+    {
+        palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+        palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+    }
+
+    uint32_t indices = 0;
+    if (endpoints[0] != endpoints[1])
+    {
+        for (int i = 0; i < 16; i++)
+        {
+            int best = 0;
+            float bestDistance = 1e30f;
+            for (int p = 0; p < 4; p++)
+            {
+                float distance = 0.0f;
+                for (int c = 0; c < 3; c++)
+                    distance += (texels[i][c] - palette[p][c]) * (texels[i][c] - palette[p][c]);
+                if (distance < bestDistance)
+                {
+                    bestDistance = distance;
+                    best = p;
+                }
+            }
+            indices |= (uint32_t)best << (2 * i);
+        }
+    }
+
+    out[0] = endpoints[0] & 0xFF;
+    out[1] = endpoints[0] >> 8;
+    out[2] = endpoints[1] & 0xFF;
+    out[3] = endpoints[1] >> 8;
+    for (int b = 0; b < 4; b++)
+        out[4 + b] = (indices >> (8 * b)) & 0xFF;
+}
+
+// BC4 block (also the alpha half of BC3): maximum and minimum as endpoints with the six values in between
+void EncodeChannelBlock(const unsigned char values[16], unsigned char *out)
+{
+    unsigned char lowest = 255, highest = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        lowest = min(lowest, values[i]);
+        highest = max(highest, values[i]);
+    }
+    out[0] = highest;
+    out[1] = lowest;
+
+    uint64_t indices = 0;
+    if (highest != lowest)
+    {
+        for (int i = 0; i < 16; i++)
+        {
+            // step 0 is the maximum, step 7 the minimum; the codes in between are stored shifted by one
+            int step = (int)((highest - values[i]) * 7.0f / (highest - lowest) + 0.5f);
+            int code = step == 0 ? 0 : step == 7 ? 1 : step + 1;
+            indices |= (uint64_t)code << (3 * i);
+        }
+    }
+    for (int b = 0; b < 6; b++)
+        out[2 + b] = (indices >> (8 * b)) & 0xFF;
+}
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef TEXTURE_FORMAT_H
+#define TEXTURE_FORMAT_H
+
+#include <glad/glad.h>
+#include <learnopengl/texture_compression.h>
+
+// how a decoded image is stored on the GPU
+struct TextureFormat {
+    GLenum internalFormat;
+    GLenum dataFormat;          // layout of the decoded pixels handed to glTexImage2D
+    GLenum dataType;
+    GLint swizzle[4];           // single channel formats replicate red so shaders reading .rgb keep working
+    unsigned int texelBytes;    // GPU storage per texel
+    const char *name;
+};
+
+TextureFormat ChooseTextureFormat(TextureRole role, bool srgb, int channels, int bytesPerChannel);
+unsigned int UnsizedFormatBytes(int channels);
+
+// the tightest format that keeps everything the role needs
+TextureFormat ChooseTextureFormat(TextureRole role, bool srgb, int channels, int bytesPerChannel)
+{
+    TextureFormat format;
+    format.dataFormat = channels == 1 ? GL_RED : channels == 2 ? GL_RG : channels == 3 ? GL_RGB : GL_RGBA;
+    format.dataType = bytesPerChannel == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_BYTE;
+    GLint identity[4] = {GL_RED, GL_GREEN, GL_BLUE, GL_ALPHA};
+    GLint red[4] = {GL_RED, GL_RED, GL_RED, GL_ONE};
+    GLint redAlpha[4] = {GL_RED, GL_RED, GL_RED, GL_GREEN};
+    const GLint *swizzle = identity;
+
+    switch (role)
+    {
+    case TextureRole::Albedo:
+        if (channels >= 3)
+        {
+            // RGB8 is padded to 4 bytes by every desktop driver, so it doesn't save anything over RGBA8
+            format.internalFormat = channels == 4 ? (srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8) : (srgb ? GL_SRGB8 : GL_RGB8);
+            format.texelBytes = 4;
+            format.name = channels == 4 ? (srgb ? "SRGB8_ALPHA8" : "RGBA8") : (srgb ? "SRGB8" : "RGB8");
+        }
+        else
+        {
+            // grey (+ alpha) images; core GL has no single channel sRGB format so these stay linear
+            format.internalFormat = channels == 1 ? GL_R8 : GL_RG8;
+            format.texelBytes = channels;
+            format.name = channels == 1 ? "R8" : "RG8";
+            swizzle = channels == 1 ? red : redAlpha;
+        }
+        break;
+    case TextureRole::Normal:
+        format.internalFormat = GL_RG8;
+        format.texelBytes = 2;
+        format.name = "RG8";
+        break;
+    case TextureRole::Height:
+        format.internalFormat = bytesPerChannel == 2 ? GL_R16 : GL_R8;
+        format.texelBytes = bytesPerChannel;
+        format.name = bytesPerChannel == 2 ? "R16" : "R8";
+        swizzle = red;
+        break;
+    case TextureRole::Roughness:
+    case TextureRole::AmbientOcclusion:
+    case TextureRole::Specular:
+        format.internalFormat = GL_R8;
+        format.texelBytes = 1;
+        format.name = "R8";
+        swizzle = red;
+        break;
+    }
+    for (int i = 0; i < 4; i++)
+        format.swizzle[i] = swizzle[i];
+    return format;
+}
+
+// bytes per texel of the unsized GL_RED/GL_RG/GL_RGB/GL_RGBA formats picked from the channel count alone,
+// which is how textures were stored before roles existed
+unsigned int UnsizedFormatBytes(int channels)
+{
+    return channels >= 3 ? 4 : channels;
+}
+
+#endif
@@ -0,0 +1,546 @@
+#ifndef TEXTURE_STREAMER_H
+#define TEXTURE_STREAMER_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/cooked_texture.h>
+#include <learnopengl/gl_ext.h>
+#include <learnopengl/gl_state.h>
+#include <learnopengl/image.h>
+#include <learnopengl/texture_format.h>
+#include <learnopengl/thread_pool.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+// how a streamed texture is stored and sampled
+struct TextureSettings {
+    TextureRole role = TextureRole::Albedo;     // picks the GPU format, see ChooseTextureFormat
+    bool srgb = false;                  // colour data, stored gamma corrected
+    bool flipVertically = true;         // images are stored top row first, OpenGL expects the bottom row first
+    GLint wrap = GL_REPEAT;
+    bool clampIfAlpha = false;          // images with an alpha channel clamp to edge (cut-out model textures)
+    unsigned char placeholder[4] = {128, 128, 128, 255};    // colour of the 1x1 texel shown until the image arrives
+};
+
+// asynchronous texture loading: images are decoded on the worker pool and streamed to the GPU through a ring of
+// pixel buffer objects. load() returns a texture name right away that holds a 1x1 placeholder; update() re-specifies
+// the same texture object with the real image once it is decoded, so callers never have to swap handles.
+// 2D textures and texture arrays that were cooked by the asset cooker (see cooked_texture.h) skip decoding: their
+// block compressed mip chain is mapped and copied to the GPU as is.
+class TextureStreamer
+{
+public:
+    explicit TextureStreamer(ThreadPool &pool, unsigned int pixelBufferCount = 3)
+        : pool(pool), pixelBuffers(pixelBufferCount)
+    {
+        glGenBuffers((GLsizei)pixelBuffers.size(), pixelBuffers.data());
+        // RGTC (BC4/BC5) is core since 3.0, S3TC (BC1/BC3) is an extension that practically every desktop driver has
+        support.s3tc = HasGLExtension("GL_EXT_texture_compression_s3tc");
+        support.s3tcSrgb = support.s3tc && HasGLExtension("GL_EXT_texture_sRGB");
+    }
+
+    ~TextureStreamer()
+    {
+        glState.deleteBuffers((GLsizei)pixelBuffers.size(), pixelBuffers.data());
+    }
+
+    TextureStreamer(const TextureStreamer &) = delete;
+    TextureStreamer &operator=(const TextureStreamer &) = delete;
+
+    // sourceHash is CookedTextureCache::sourceHash of the file when the caller has it already, 0 has the worker hash
+    // it; either way sourceHash(id) has it once the texture is uploaded
+    unsigned int load(const string &path, const TextureSettings &settings, uint64_t sourceHash = 0)
+    {
+        unsigned int textureID;
+        glGenTextures(1, &textureID);
+        sourceHashes.erase(textureID);
+        glState.bindTexture(GL_TEXTURE_2D, textureID);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, settings.placeholder);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, settings.wrap);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, settings.wrap);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        PendingTexture texture;
+        texture.id = textureID;
+        texture.target = GL_TEXTURE_2D;
+        texture.settings = settings;
+        texture.paths.push_back(path);
+        CompressionSupport support = this->support;
+        texture.images.push_back(pool.submit([path, settings, support, sourceHash] {
+            return loadImage(path, settings, support, sourceHash);
+        }));
+        queue(std::move(texture));
+        return textureID;
+    }
+
+    // one GL_TEXTURE_2D_ARRAY with an image per layer, so materials using any of them are drawn without rebinding
+    // textures. the images have to share size and format (see Model::upload), layers that don't are left out.
+    // sourceHashes has the layers' hashes like load() takes one, or is empty
+    unsigned int loadArray(const vector<string> &paths, const TextureSettings &settings,
+                           const vector<uint64_t> &sourceHashes = vector<uint64_t>())
+    {
+        unsigned int textureID;
+        glGenTextures(1, &textureID);
+        glState.bindTexture(GL_TEXTURE_2D_ARRAY, textureID);
+        vector<unsigned char> placeholder;
+        for (size_t i = 0; i < paths.size(); i++)
+            placeholder.insert(placeholder.end(), settings.placeholder, settings.placeholder + 4);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA, 1, 1, (GLsizei)paths.size(), 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder.data());
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, settings.wrap);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, settings.wrap);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        PendingTexture texture;
+        texture.id = textureID;
+        texture.target = GL_TEXTURE_2D_ARRAY;
+        texture.settings = settings;
+        texture.paths = paths;
+        CompressionSupport support = this->support;
+        for (size_t i = 0; i < paths.size(); i++)
+        {
+            string path = paths[i];
+            uint64_t sourceHash = i < sourceHashes.size() ? sourceHashes[i] : 0;
+            texture.images.push_back(pool.submit([path, settings, support, sourceHash] {
+                return loadImage(path, settings, support, sourceHash);
+            }));
+        }
+        queue(std::move(texture));
+        return textureID;
+    }
+
+    // cube map from six faces in +X, -X, +Y, -Y, +Z, -Z order. the faces are decoded in parallel but uploaded
+    // together, a cube map with faces of different sizes would be incomplete.
+    unsigned int loadCubemap(const vector<string> &faces)
+    {
+        unsigned int textureID;
+        glGenTextures(1, &textureID);
+        glState.bindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+        const unsigned char black[3] = {0, 0, 0};
+        for (unsigned int i = 0; i < 6; i++)
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, 1, 1, 0, GL_RGB, GL_UNSIGNED_BYTE, black);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+
+        PendingTexture texture;
+        texture.id = textureID;
+        texture.target = GL_TEXTURE_CUBE_MAP;
+        texture.settings.flipVertically = false;
+        for (const string &face : faces)
+        {
+            texture.paths.push_back(face);
+            texture.images.push_back(pool.submit([face] {
+                LoadedImage image;
+                image.decoded = DecodeImage(face, false);
+                return image;
+            }));
+        }
+        queue(std::move(texture));
+        return textureID;
+    }
+
+    // uploads decoded textures, call once per frame on the GL thread. stops after byteBudget bytes (but always
+    // uploads at least one texture) so a burst of finished 4K images doesn't stall a single frame.
+    // returns how many textures are still waiting.
+    size_t update(size_t byteBudget = 32 * 1024 * 1024)
+    {
+        size_t uploadedBytes = 0;
+        for (size_t i = 0; i < pending.size() && uploadedBytes < byteBudget; )
+        {
+            if (isReady(pending[i]))
+            {
+                uploadedBytes += upload(pending[i]);
+                pending.erase(pending.begin() + i);
+            }
+            else
+                i++;
+        }
+        if (pending.empty() && streamedTextures > 0)
+            reportFinished();
+        return pending.size();
+    }
+
+    // blocks until every queued texture is uploaded
+    void finish()
+    {
+        while (update(SIZE_MAX) > 0)
+            for (future<LoadedImage> &image : pending.front().images)
+                image.wait();
+    }
+
+    size_t pendingCount() const { return pending.size(); }
+
+    // source hash of an uploaded 2D texture from load(), 0 while it is still queued or when the file couldn't be read
+    uint64_t sourceHash(unsigned int textureID) const
+    {
+        auto found = sourceHashes.find(textureID);
+        return found == sourceHashes.end() ? 0 : found->second;
+    }
+
+    // drops the queued upload of a texture that is about to be deleted, so update() never fills a dead name (or one
+    // GL handed out again). the workers still finish decoding it, the result is thrown away
+    void forget(unsigned int textureID)
+    {
+        for (size_t i = 0; i < pending.size(); )
+        {
+            if (pending[i].id == textureID)
+                pending.erase(pending.begin() + i);
+            else
+                i++;
+        }
+        sourceHashes.erase(textureID);
+    }
+
+private:
+    // what a worker hands back: a cooked texture when there is a usable one, the decoded source image otherwise
+    struct LoadedImage {
+        unique_ptr<CookedTextureView> cooked;
+        DecodedImage decoded;
+        uint64_t sourceHash = 0;
+    };
+
+    struct CompressionSupport {
+        bool s3tc = false;
+        bool s3tcSrgb = false;
+    };
+
+    struct PendingTexture {
+        unsigned int id;
+        GLenum target;
+        TextureSettings settings;
+        vector<string> paths;
+        vector<future<LoadedImage>> images;
+    };
+
+    ThreadPool &pool;
+    CompressionSupport support;
+    vector<unsigned int> pixelBuffers;
+    unsigned int nextPixelBuffer = 0;
+    vector<PendingTexture> pending;
+    unordered_map<unsigned int, uint64_t> sourceHashes;     // texture name -> source hash, see sourceHash()
+    chrono::steady_clock::time_point start;
+    unsigned int streamedTextures = 0;
+    size_t streamedBytes = 0;
+    double videoMegabytes = 0.0;
+    double savedMegabytes = 0.0;
+
+    void queue(PendingTexture texture)
+    {
+        if (pending.empty() && streamedTextures == 0)
+            start = chrono::steady_clock::now();
+        pending.push_back(std::move(texture));
+    }
+
+    static bool isReady(PendingTexture &texture)
+    {
+        for (future<LoadedImage> &image : texture.images)
+            if (image.wait_for(chrono::seconds(0)) != future_status::ready)
+                return false;
+        return true;
+    }
+
+    size_t upload(PendingTexture &texture)
+    {
+        size_t bytes = 0;
+        glState.bindTexture(texture.target, texture.id);
+        // tightly packed rows, RGB images with odd widths aren't 4 byte aligned
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        if (texture.target == GL_TEXTURE_2D_ARRAY)
+            bytes = uploadArray(texture);
+        for (size_t face = 0; texture.target != GL_TEXTURE_2D_ARRAY && face < texture.images.size(); face++)
+        {
+            LoadedImage loaded = texture.images[face].get();
+            if (texture.target == GL_TEXTURE_2D)
+                sourceHashes[texture.id] = loaded.sourceHash;
+            if (loaded.cooked)
+            {
+                bytes += streamCooked(texture, *loaded.cooked);
+                continue;
+            }
+            DecodedImage &image = loaded.decoded;
+            if (!image.pixels)
+            {
+                std::cout << "Texture failed to load at path: " << texture.paths[face] << std::endl;
+                continue;
+            }
+
+            TextureFormat format = ChooseTextureFormat(texture.settings.role, texture.settings.srgb, image.channels, image.bytesPerChannel);
+            GLenum target = texture.target == GL_TEXTURE_CUBE_MAP ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + (GLenum)face : texture.target;
+            streamImage(target, format, image);
+            bytes += image.size();
+
+            if (texture.target == GL_TEXTURE_2D)
+            {
+                glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, format.swizzle);
+                glGenerateMipmap(GL_TEXTURE_2D);
+                bool alpha = format.dataFormat == GL_RGBA && texture.settings.role == TextureRole::Albedo;
+                GLint wrap = texture.settings.clampIfAlpha && alpha ? GL_CLAMP_TO_EDGE : texture.settings.wrap;
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
+                reportTexture(texture.paths[face], format.name, image.width, image.height, format.texelBytes,
+                              UnsizedFormatBytes(image.channels));
+            }
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        streamedTextures++;
+        streamedBytes += bytes;
+        return bytes;
+    }
+
+    // the layers are uploaded cooked when every one of them has a cooked texture of the same codec and size, otherwise
+    // all of them are decoded (the cooked ones here on the GL thread, which only happens after a partial cooker run)
+    size_t uploadArray(PendingTexture &texture)
+    {
+        vector<LoadedImage> layers;
+        for (future<LoadedImage> &image : texture.images)
+            layers.push_back(image.get());
+        bool cooked = layers[0].cooked != nullptr;
+        for (LoadedImage &layer : layers)
+            cooked = cooked && layer.cooked && layer.cooked->codec() == layers[0].cooked->codec() &&
+                     layer.cooked->header->width == layers[0].cooked->header->width &&
+                     layer.cooked->header->height == layers[0].cooked->header->height &&
+                     layer.cooked->header->levelCount == layers[0].cooked->header->levelCount;
+        if (cooked)
+            return streamCookedArray(texture, layers);
+        for (size_t i = 0; i < layers.size(); i++)
+        {
+            if (!layers[i].cooked)
+                continue;
+            layers[i].cooked.reset();
+            layers[i].decoded = DecodeImage(texture.paths[i], texture.settings.flipVertically, 0, texture.settings.role == TextureRole::Height);
+        }
+        return streamDecodedArray(texture, layers);
+    }
+
+    // runs on a worker: maps the cooked version of path if the cooker produced one this driver can use,
+    // decodes the source image otherwise. the file is only hashed when sourceHash doesn't have it already
+    static LoadedImage loadImage(const string &path, const TextureSettings &settings, CompressionSupport support,
+                                 uint64_t sourceHash)
+    {
+        LoadedImage image;
+        uint64_t hash = sourceHash ? sourceHash : CookedTextureCache::sourceHash(path);
+        image.sourceHash = hash;
+        unique_ptr<CookedTextureView> cooked(new CookedTextureView);
+        if (CookedTextureCache::open(CookedTextureCache::cachePath(hash, settings.srgb), hash, *cooked) &&
+            usable(*cooked, settings, support))
+            image.cooked = std::move(cooked);
+        else
+            image.decoded = DecodeImage(path, settings.flipVertically, 0, settings.role == TextureRole::Height);
+        return image;
+    }
+
+    // a cooked texture only stands in for its source when it was cooked the way the texture is used: rows in the same
+    // order, mips averaged in the colour space it is sampled in (or every mip comes out brighter or darker than
+    // glGenerateMipmap would make it) and a codec keeping the channels its role needs. the cooker guesses roles from
+    // file names, so a normal map that isn't called one arrives as BC1 and is decoded instead
+    static bool usable(const CookedTextureView &cooked, const TextureSettings &settings, CompressionSupport support)
+    {
+        return (bool)cooked.header->flipped == settings.flipVertically && (bool)cooked.header->srgb == settings.srgb &&
+               TextureCodecFitsRole(cooked.codec(), settings.role) && compressedFormat(cooked.codec(), settings.srgb, support) != 0;
+    }
+
+    // GL format of a cooked texture, 0 when the driver can't sample it
+    static GLenum compressedFormat(TextureCodec codec, bool srgb, CompressionSupport support)
+    {
+        switch (codec)
+        {
+        case TextureCodec::BC1:
+            if (!support.s3tc || (srgb && !support.s3tcSrgb))
+                return 0;
+            return srgb ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        case TextureCodec::BC3:
+            if (!support.s3tc || (srgb && !support.s3tcSrgb))
+                return 0;
+            return srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        // single and two channel data (heights, normals) has no sRGB form
+        case TextureCodec::BC4:
+            return GL_COMPRESSED_RED_RGTC1;
+        case TextureCodec::BC5:
+            return GL_COMPRESSED_RG_RGTC2;
+        }
+        return 0;
+    }
+
+    // uploads the whole precomputed mip chain of a cooked texture, no glGenerateMipmap needed
+    size_t streamCooked(PendingTexture &texture, const CookedTextureView &cooked)
+    {
+        GLenum internalFormat = compressedFormat(cooked.codec(), texture.settings.srgb, support);
+        const unsigned char *data = static_cast<const unsigned char *>(stage(cooked.data, cooked.header->dataSize));
+        for (uint32_t level = 0; level < cooked.header->levelCount; level++)
+        {
+            const CookedTextureLevel &entry = cooked.levels[level];
+            glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)level, internalFormat, entry.width, entry.height, 0,
+                                   (GLsizei)entry.size, data + entry.offset);
+        }
+        glState.bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)cooked.header->levelCount - 1);
+
+        bool alpha = cooked.codec() == TextureCodec::BC3;
+        GLint wrap = texture.settings.clampIfAlpha && alpha ? GL_CLAMP_TO_EDGE : texture.settings.wrap;
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
+
+        // block sizes don't divide into bytes per texel, so the report gets fractional texel sizes
+        double texels = (double)cooked.header->width * cooked.header->height;
+        reportTexture(texture.paths[0], TextureCodecName(cooked.codec()), cooked.header->width, cooked.header->height,
+                      cooked.levels[0].size / texels, UnsizedFormatBytes(cooked.codec() == TextureCodec::BC4 ? 1 : 4));
+        return cooked.header->dataSize;
+    }
+
+    size_t streamCookedArray(PendingTexture &texture, const vector<LoadedImage> &layers)
+    {
+        const CookedTextureView &first = *layers[0].cooked;
+        GLenum internalFormat = compressedFormat(first.codec(), texture.settings.srgb, support);
+        GLsizei depth = (GLsizei)layers.size();
+        for (uint32_t level = 0; level < first.header->levelCount; level++)
+        {
+            const CookedTextureLevel &entry = first.levels[level];
+            glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, (GLint)level, internalFormat, entry.width, entry.height, depth, 0,
+                                   (GLsizei)(entry.size * layers.size()), nullptr);
+        }
+        size_t bytes = 0;
+        for (size_t layer = 0; layer < layers.size(); layer++)
+        {
+            const CookedTextureView &cooked = *layers[layer].cooked;
+            const unsigned char *data = static_cast<const unsigned char *>(stage(cooked.data, cooked.header->dataSize));
+            for (uint32_t level = 0; level < cooked.header->levelCount; level++)
+            {
+                const CookedTextureLevel &entry = cooked.levels[level];
+                glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, (GLint)level, 0, 0, (GLint)layer, entry.width, entry.height, 1,
+                                          internalFormat, (GLsizei)entry.size, data + entry.offset);
+            }
+            glState.bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            bytes += cooked.header->dataSize;
+            double texels = (double)cooked.header->width * cooked.header->height;
+            reportTexture(texture.paths[layer], TextureCodecName(cooked.codec()), cooked.header->width, cooked.header->height,
+                          cooked.levels[0].size / texels, UnsizedFormatBytes(cooked.codec() == TextureCodec::BC4 ? 1 : 4));
+        }
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, (GLint)first.header->levelCount - 1);
+
+        bool alpha = first.codec() == TextureCodec::BC3;
+        GLint wrap = texture.settings.clampIfAlpha && alpha ? GL_CLAMP_TO_EDGE : texture.settings.wrap;
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, wrap);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, wrap);
+        return bytes;
+    }
+
+    // the first layer that decoded decides size and format, the array keeps its placeholder if none did
+    size_t streamDecodedArray(PendingTexture &texture, const vector<LoadedImage> &layers)
+    {
+        size_t reference = 0;
+        while (reference < layers.size() && !layers[reference].decoded.pixels)
+            reference++;
+        if (reference == layers.size())
+        {
+            std::cout << "Texture array failed to load, first layer: " << texture.paths[0] << std::endl;
+            return 0;
+        }
+        const DecodedImage &first = layers[reference].decoded;
+        TextureFormat format = ChooseTextureFormat(texture.settings.role, texture.settings.srgb, first.channels, first.bytesPerChannel);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, format.internalFormat, first.width, first.height, (GLsizei)layers.size(), 0,
+                     format.dataFormat, format.dataType, nullptr);
+        size_t bytes = 0;
+        for (size_t layer = 0; layer < layers.size(); layer++)
+        {
+            const DecodedImage &image = layers[layer].decoded;
+            if (!image.pixels)
+            {
+                std::cout << "Texture failed to load at path: " << texture.paths[layer] << std::endl;
+                continue;
+            }
+            if (image.width != first.width || image.height != first.height || image.channels != first.channels ||
+                image.bytesPerChannel != first.bytesPerChannel)
+            {
+                std::cout << "Texture doesn't match the other layers of its array: " << texture.paths[layer] << std::endl;
+                continue;
+            }
+            const void *pixels = stage(image.pixels.get(), image.size());
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, (GLint)layer, image.width, image.height, 1, format.dataFormat,
+                            format.dataType, pixels);
+            glState.bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            bytes += image.size();
+            reportTexture(texture.paths[layer], format.name, image.width, image.height, format.texelBytes,
+                          UnsizedFormatBytes(image.channels));
+        }
+        glTexParameteriv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_SWIZZLE_RGBA, format.swizzle);
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+        bool alpha = format.dataFormat == GL_RGBA && texture.settings.role == TextureRole::Albedo;
+        GLint wrap = texture.settings.clampIfAlpha && alpha ? GL_CLAMP_TO_EDGE : texture.settings.wrap;
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, wrap);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, wrap);
+        return bytes;
+    }
+
+    void streamImage(GLenum target, const TextureFormat &format, const DecodedImage &image)
+    {
+        const void *pixels = stage(image.pixels.get(), image.size());
+        glTexImage2D(target, 0, format.internalFormat, image.width, image.height, 0, format.dataFormat, format.dataType, pixels);
+        glState.bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    // copies data into the next pixel buffer of the ring and leaves it bound, so the upload that follows is sourced
+    // from it and the driver can DMA the data while we go on; the buffer is orphaned first to avoid waiting on its
+    // previous use. returns the pointer the upload has to be given: offset 0 of the buffer, or data itself when
+    // mapping failed and the upload has to come from client memory.
+    const void *stage(const void *data, size_t size)
+    {
+        unsigned int pixelBuffer = pixelBuffers[nextPixelBuffer];
+        nextPixelBuffer = (nextPixelBuffer + 1) % pixelBuffers.size();
+
+        glState.bindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+        void *mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (mapped)
+        {
+            memcpy(mapped, data, size);
+            if (glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER))
+                return (void*)0;
+        }
+        // mapping failed (or the buffer got corrupted)
+        glState.bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return data;
+    }
+
+    // one line per 2D texture: its format, its video memory (with mips) and the difference to the format picked
+    // from the channel count alone, which is how every texture used to be stored
+    void reportTexture(const string &path, const char *format, int width, int height, double texelBytes, double previousTexelBytes)
+    {
+        double texels = (double)width * height * 4.0 / 3.0;
+        double megabytes = texels * texelBytes / (1024 * 1024);
+        double saved = texels * previousTexelBytes / (1024 * 1024) - megabytes;
+        videoMegabytes += megabytes;
+        savedMegabytes += saved;
+        std::cout << "TEXTURE_STREAMER:: " << path.substr(path.find_last_of('/') + 1) << " " << format << " " << width
+                  << "x" << height << ", " << megabytes << " MB";
+        if (saved >= 0.0)
+            std::cout << " (" << saved << " MB saved)" << std::endl;
+        else
+            std::cout << " (" << -saved << " MB more for the extra precision)" << std::endl;
+    }
+
+    void reportFinished()
+    {
+        double milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        std::cout << "TEXTURE_STREAMER:: " << streamedTextures << " textures (" << streamedBytes / (1024 * 1024)
+                  << " MB) streamed in " << milliseconds << " ms, " << videoMegabytes << " MB of video memory, "
+                  << savedMegabytes << " MB saved" << std::endl;
+        streamedTextures = 0;
+        streamedBytes = 0;
+        videoMegabytes = savedMegabytes = 0.0;
+    }
+};
+
+#endif
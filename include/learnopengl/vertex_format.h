@@ -0,0 +1,182 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+// GPU vertex and index layouts. meshes are imported and cached as full float Vertex structs and 32 bit indices;
+// these only decide how MeshUploader stores them in the buffers.
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/mesh_data.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+using namespace std;
+
+enum class VertexLayout {
+    Float,      // Vertex as is, 56 bytes
+    Compact,    // PackedVertex, 20 bytes
+};
+
+// position quantized to 16 bit against the mesh bounds, normal and tangent as signed normalized 10_10_10_2
+// (the tangent's 2 bit w is the bitangent's handedness), texture coordinates as half floats.
+// the GPU does most of the decoding through normalized attributes; the shaders only scale the position back
+// (meshPositionOffset/meshPositionScale, set by Mesh::Draw) and rebuild the bitangent as cross(N, T) * w.
+struct PackedVertex {
+    uint16_t position[4];   // xyz, w is padding
+    uint32_t normal;
+    uint32_t tangent;
+    uint16_t texCoords[2];
+};
+static_assert(sizeof(PackedVertex) == 20, "PackedVertex has to stay tightly packed");
+
+// a run of indices drawn with one call; the stored indices are relative to baseVertex
+struct IndexRange {
+    unsigned int firstIndex;
+    unsigned int indexCount;
+    int baseVertex;
+};
+
+// index buffer contents, 16 bit whenever the vertices referenced by each range fit
+struct PackedIndices {
+    unsigned int indexSize = 4;     // bytes per index, 2 or 4
+    vector<unsigned char> data;
+    vector<IndexRange> ranges;
+};
+
+// below this many triangles per range the extra draw calls cost more than the halved index reads save
+const unsigned int MIN_TRIANGLES_PER_INDEX_RANGE = 1024;
+
+vector<PackedVertex> PackVertices(const Vertex *vertices, unsigned int count, glm::vec3 boundsMin, glm::vec3 boundsMax);
+uint32_t PackSnorm1010102(glm::vec3 value, float w);
+uint16_t PackHalf(float value);
+PackedIndices PackIndices(const unsigned int *indices, unsigned int count, unsigned int vertexCount);
+
+vector<PackedVertex> PackVertices(const Vertex *vertices, unsigned int count, glm::vec3 boundsMin, glm::vec3 boundsMax)
+{
+    vector<PackedVertex> packed(count);
+    glm::vec3 extent = boundsMax - boundsMin;
+    for (unsigned int i = 0; i < count; i++)
+    {
+        const Vertex &vertex = vertices[i];
+        PackedVertex &out = packed[i];
+        for (int c = 0; c < 3; c++)
+        {
+            float normalized = extent[c] > 0.0f ? (vertex.Position[c] - boundsMin[c]) / extent[c] : 0.0f;
+            out.position[c] = (uint16_t)(min(max(normalized, 0.0f), 1.0f) * 65535.0f + 0.5f);
+        }
+        out.position[3] = 0;
+        out.normal = PackSnorm1010102(vertex.Normal, 0.0f);
+        float handedness = glm::dot(glm::cross(vertex.Normal, vertex.Tangent), vertex.Bitangent) < 0.0f ? -1.0f : 1.0f;
+        out.tangent = PackSnorm1010102(vertex.Tangent, handedness);
+        out.texCoords[0] = PackHalf(vertex.TexCoords.x);
+        out.texCoords[1] = PackHalf(vertex.TexCoords.y);
+    }
+    return packed;
+}
+
+// layout of GL_INT_2_10_10_10_REV: x in the lowest 10 bits, w in the top 2
+uint32_t PackSnorm1010102(glm::vec3 value, float w)
+{
+    uint32_t packed = 0;
+    for (int c = 0; c < 3; c++)
+    {
+        int quantized = (int)lround(min(max(value[c], -1.0f), 1.0f) * 511.0f);
+        packed |= ((uint32_t)quantized & 0x3FF) << (10 * c);
+    }
+    // -2 rather than -1: GL before 4.2 maps a 2 bit -1 to -1/3, both conventions map -2 to -1
+    int sign = w < 0.0f ? -2 : w > 0.0f ? 1 : 0;
+    packed |= ((uint32_t)sign & 0x3) << 30;
+    return packed;
+}
+
+// IEEE 754 binary16, rounded to nearest; out of range values become infinity, tiny ones denormals or zero
+uint16_t PackHalf(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+    int exponent = (int)((bits >> 23) & 0xFF) - 127 + 15;
+    uint32_t mantissa = bits & 0x7FFFFF;
+
+    if (((bits >> 23) & 0xFF) == 0xFF)
+        return (uint16_t)(sign | 0x7C00 | (mantissa ? 0x200 : 0));
+    if (exponent >= 31)
+        return (uint16_t)(sign | 0x7C00);
+    if (exponent <= 0)
+    {
+        if (exponent < -10)
+            return sign;
+        mantissa |= 0x800000;
+        int shift = 14 - exponent;
+        uint32_t half = mantissa >> shift;
+        if ((mantissa >> (shift - 1)) & 1)
+            half++;
+        return (uint16_t)(sign | half);
+    }
+    uint32_t half = ((uint32_t)exponent << 10) | (mantissa >> 13);
+    // round to nearest, a carry into the exponent is the correct result
+    if (mantissa & 0x1000)
+        half++;
+    return (uint16_t)(sign | half);
+}
+
+// meshes with up to 65536 vertices get 16 bit indices as they are. larger ones are cut into ranges of consecutive
+// triangles whose vertices span less than 65536, each drawn with its own base vertex; after OptimizeVertexFetch
+// vertices are numbered in order of first use, so such spans are long. when a mesh would fall apart into too many
+// small ranges it keeps 32 bit indices.
+PackedIndices PackIndices(const unsigned int *indices, unsigned int count, unsigned int vertexCount)
+{
+    PackedIndices packed;
+    if (count == 0)
+        return packed;
+
+    if (vertexCount <= 65536)
+        packed.ranges.push_back({0, count, 0});
+    else
+    {
+        bool fits = true;
+        unsigned int first = 0, low = 0, high = 0;
+        for (unsigned int i = 0; i + 2 < count; i += 3)
+        {
+            unsigned int triangleLow = min(indices[i], min(indices[i + 1], indices[i + 2]));
+            unsigned int triangleHigh = max(indices[i], max(indices[i + 1], indices[i + 2]));
+            if (triangleHigh - triangleLow > 65535)
+            {
+                fits = false;
+                break;
+            }
+            if (i != first && max(high, triangleHigh) - min(low, triangleLow) > 65535)
+            {
+                packed.ranges.push_back({first, i - first, (int)low});
+                first = i;
+            }
+            low = i == first ? triangleLow : min(low, triangleLow);
+            high = i == first ? triangleHigh : max(high, triangleHigh);
+        }
+        if (fits)
+            packed.ranges.push_back({first, count - first, (int)low});
+        if (!fits || count / 3 / packed.ranges.size() < MIN_TRIANGLES_PER_INDEX_RANGE)
+            packed.ranges.clear();
+    }
+
+    if (packed.ranges.empty())
+    {
+        packed.ranges.push_back({0, count, 0});
+        packed.data.resize((size_t)count * sizeof(unsigned int));
+        memcpy(packed.data.data(), indices, packed.data.size());
+        return packed;
+    }
+
+    packed.indexSize = 2;
+    packed.data.resize((size_t)count * sizeof(uint16_t));
+    uint16_t *out = reinterpret_cast<uint16_t *>(packed.data.data());
+    for (const IndexRange &range : packed.ranges)
+        for (unsigned int i = range.firstIndex; i < range.firstIndex + range.indexCount; i++)
+            out[i] = (uint16_t)(indices[i] - (unsigned int)range.baseVertex);
+    return packed;
+}
+
+#endif
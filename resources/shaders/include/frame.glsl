@@ -0,0 +1,7 @@
+// per frame data shared by every shader, see FrameBlock
+layout (std140) uniform Frame {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPosition;
+    float time;
+};
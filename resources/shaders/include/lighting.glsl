@@ -0,0 +1,51 @@
+#include "lights.glsl"
+
+// the light functions take the material's samples instead of reading the textures themselves, so a fragment
+// samples each texture once however many lights it adds up.
+
+// specular factor of a light shining from lightDir. Blinn-Phong when compiled with BLINN, it needs about four
+// times the exponent for a highlight the size Phong gives.
+float SpecularFactor(vec3 lightDir, vec3 normal, vec3 viewDir, float shininess)
+{
+#ifdef BLINN
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    return pow(max(dot(normal, halfwayDir), 0.0), shininess * 4.0);
+#else
+    vec3 reflectDir = reflect(-lightDir, normal);
+    return pow(max(dot(viewDir, reflectDir), 0.0), shininess);
+#endif
+}
+
+// calculates the color when using a directional light.
+vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, vec3 color, float specularIntensity, float shininess)
+{
+    vec3 lightDir = normalize(-light.direction);
+    // diffuse shading
+    float diff = max(dot(normal, lightDir), 0.0);
+    // specular shading
+    float spec = SpecularFactor(lightDir, normal, viewDir, shininess);
+    // combine results
+    vec3 ambient = light.ambient * color;
+    vec3 diffuse = light.diffuse * diff * color;
+    vec3 specular = light.specular * spec * specularIntensity;
+    return (ambient + diffuse + specular);
+}
+
+// calculates the color when using a point light.
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 color, float specularIntensity,
+                    float shininess)
+{
+    vec3 lightDir = normalize(light.position - fragPos);
+    // diffuse shading
+    float diff = max(dot(normal, lightDir), 0.0);
+    // specular shading
+    float spec = SpecularFactor(lightDir, normal, viewDir, shininess);
+    // attenuation
+    float distance = length(light.position - fragPos);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+    // combine results
+    vec3 ambient = light.ambient * color;
+    vec3 diffuse = light.diffuse * diff * color;
+    vec3 specular = light.specular * spec * specularIntensity;
+    return (ambient + diffuse + specular) * attenuation;
+}
@@ -0,0 +1,24 @@
+struct DirLight {
+    vec3 direction;
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+struct PointLight {
+    vec3 position;
+
+    vec3 specular;
+    vec3 diffuse;
+    vec3 ambient;
+
+    float constant;
+    float linear;
+    float quadratic;
+};
+
+// lights shared by every shader, see LightingBlock
+layout (std140) uniform Lighting {
+    DirLight dirLight;
+    PointLight pointLight;
+};
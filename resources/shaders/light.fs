@@ -1,28 +1,13 @@
 #version 330 core
+// variants (see ShaderVariants): BLINN switches the specular term to Blinn-Phong, DOUBLE_LIGHT doubles the result
 out vec4 FragColor;
 
-struct DirLight {
-    vec3 direction;
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
-
-struct PointLight {
-    vec3 position;
-
-    vec3 specular;
-    vec3 diffuse;
-    vec3 ambient;
-
-    float constant;
-    float linear;
-    float quadratic;
-};
-
 struct Material {
     sampler2D texture_diffuse1;
     sampler2D texture_specular1;
+    // the same textures as layers of the model's texture arrays, see Material::textureArrays
+    sampler2DArray texture_diffuse_array;
+    sampler2DArray texture_specular_array;
 
     float shininess;
 };
@@ -30,90 +15,40 @@ struct Material {
 in vec2 TexCoords;
 in vec3 Normal;
 in vec3 FragPos;
+flat in ivec4 MaterialLayers;
 
-
-uniform DirLight dirLight;
-uniform PointLight pointLight;
 uniform Material material;
 
-uniform vec3 viewPosition;
-uniform bool blinn;
-uniform bool switchLight;
+#include "include/frame.glsl"
+#include "include/lighting.glsl"
 
+uniform bool meshTextureArrays;
 
-
-// calculates the color when using a point light.
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
+vec3 DiffuseColor()
 {
-    vec3 lightDir = normalize(light.position - fragPos);
-    // diffuse shading
-    float diff = max(dot(normal, lightDir), 0.0);
-    // specular shading
-    vec3 reflectDir = reflect(-lightDir, normal);
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-    // attenuation
-    float distance = length(light.position - fragPos);
-    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
-    // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.texture_specular1, TexCoords).xxx);
-    ambient *= attenuation;
-    diffuse *= attenuation;
-    specular *= attenuation;
-    return (ambient + diffuse + specular);
+    if(meshTextureArrays)
+        return texture(material.texture_diffuse_array, vec3(TexCoords, MaterialLayers.x)).rgb;
+    return texture(material.texture_diffuse1, TexCoords).rgb;
 }
 
-// calculates the color when using a directional light.
-vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
+float SpecularIntensity()
 {
-    vec3 lightDir = normalize(-light.direction);
-    // diffuse shading
-    float diff = max(dot(normal, lightDir), 0.0);
-    // specular shading
-    vec3 reflectDir = reflect(-lightDir, normal);
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-    // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.texture_specular1, TexCoords).xxx);
-    return (ambient + diffuse + specular);
+    if(meshTextureArrays)
+        return texture(material.texture_specular_array, vec3(TexCoords, MaterialLayers.y)).x;
+    return texture(material.texture_specular1, TexCoords).x;
 }
 
-
-
 void main()
 {
-    vec3 color = texture(material.texture_diffuse1, TexCoords).rgb;
-    // ambient
-    vec3 ambient = 0.05 * color;
-    // diffuse
-    vec3 lightDir = normalize(pointLight.position - FragPos);
+    vec3 color = DiffuseColor();
+    float specularIntensity = SpecularIntensity();
     vec3 normal = normalize(Normal);
-    float diff = max(dot(lightDir, normal), 0.0);
-    vec3 diffuse = diff * color;
-    // specular
     vec3 viewDir = normalize(viewPosition - FragPos);
-    vec3 reflectDir = reflect(-lightDir, normal);
-    float spec = 0.0;
-    if(blinn)
-    {
-         vec3 halfwayDir = normalize(lightDir + viewDir);
-         spec = pow(max(dot(normal, halfwayDir), 0.0), 32.0);
-    }
-    else
-    {
-        vec3 reflectDir = reflect(-lightDir, normal);
-        spec = pow(max(dot(viewDir, reflectDir), 0.0), 8.0);
-    }
-    vec3 specular = vec3(0.3) * spec; // assuming bright white light color
-    vec3 result = ambient + diffuse + specular;
-    result += CalcDirLight(dirLight, normal, viewDir);
-    result += CalcPointLight(pointLight, normal, FragPos, viewDir);
-    if(switchLight)
-    {
-            result += result;
-    }
-    FragColor = vec4(result, 1.0);
 
-}
\ No newline at end of file
+    vec3 result = CalcDirLight(dirLight, normal, viewDir, color, specularIntensity, material.shininess);
+    result += CalcPointLight(pointLight, normal, FragPos, viewDir, color, specularIntensity, material.shininess);
+#ifdef DOUBLE_LIGHT
+    result *= 2.0;
+#endif
+    FragColor = vec4(result, 1.0);
+}
@@ -2,19 +2,37 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+layout (location = 5) in mat4 aInstance;
+// per draw data of Model::DrawIndirect, see IndirectInstance
+layout (location = 9) in vec4 aDrawPositionOffset;
+layout (location = 10) in vec4 aDrawPositionScale;
+layout (location = 11) in ivec4 aDrawMaterialLayers;
 
 out vec2 TexCoords;
 out vec3 Normal;
 out vec3 FragPos;
+flat out ivec4 MaterialLayers;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#include "include/frame.glsl"
+// quantized positions are stored relative to the mesh bounds, see Mesh::Draw
+uniform vec3 meshPositionOffset;
+uniform vec3 meshPositionScale;
+// meshes imported with MODEL_IMPORT_INSTANCE_DUPLICATES, and Model::DrawInstanced, carry a transform per instance
+uniform bool meshInstanced;
+// layers of the material texture arrays, see Material::layers
+uniform ivec4 meshMaterialLayers;
+// drawn by Model::DrawIndirect: the per mesh values above come from attributes instead
+uniform bool drawIndirect;
 
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = aNormal;
+    vec3 position = drawIndirect ? aDrawPositionOffset.xyz + aPos * aDrawPositionScale.xyz
+                                 : meshPositionOffset + aPos * meshPositionScale;
+    mat4 instance = meshInstanced || drawIndirect ? aInstance : mat4(1.0);
+    MaterialLayers = drawIndirect ? aDrawMaterialLayers : meshMaterialLayers;
+    FragPos = vec3(model * instance * vec4(position, 1.0));
+    Normal = mat3(instance) * aNormal;
     TexCoords = aTexCoords;
     gl_Position = projection * view * vec4(FragPos, 1.0);
 }
\ No newline at end of file
@@ -4,6 +4,7 @@ layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
 layout (location = 3) in vec3 aTangent;
 layout (location = 4) in vec3 aBitangent;
+layout (location = 5) in mat4 aInstance;
 
 out VS_OUT {
     vec3 FragPos;
@@ -13,28 +14,29 @@ out VS_OUT {
     vec3 TangentFragPos;
 } vs_out;
 
-uniform mat4 projection;
-uniform mat4 view;
 uniform mat4 model;
+// set when aInstance holds a transform per instance, see Mesh::DrawInstances
+uniform bool meshInstanced;
 
-uniform vec3 lightPos;
-uniform vec3 viewPos;
+#include "include/frame.glsl"
+#include "include/lights.glsl"
 
 void main()
 {
-    vs_out.FragPos = vec3(model * vec4(aPos, 1.0));
+    mat4 world = meshInstanced ? model * aInstance : model;
+    vs_out.FragPos = vec3(world * vec4(aPos, 1.0));
     vs_out.TexCoords = aTexCoords;
 
-    mat3 normalMatrix = transpose(inverse(mat3(model)));
+    mat3 normalMatrix = transpose(inverse(mat3(world)));
     vec3 T = normalize(normalMatrix * aTangent);
     vec3 N = normalize(normalMatrix * aNormal);
     T = normalize(T - dot(T, N) * N);
     vec3 B = cross(N, T);
 
     mat3 TBN = transpose(mat3(T, B, N));
-    vs_out.TangentLightPos = TBN * lightPos;
-    vs_out.TangentViewPos  = TBN * viewPos;
+    vs_out.TangentLightPos = TBN * pointLight.position;
+    vs_out.TangentViewPos  = TBN * viewPosition;
     vs_out.TangentFragPos  = TBN * vs_out.FragPos;
 
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    gl_Position = projection * view * vec4(vs_out.FragPos, 1.0);
 }
\ No newline at end of file
@@ -32,8 +32,10 @@ void main()
         discard;
 
     // obtain normal from normal map
-    vec3 normal = texture(normalMap, texCoords).rgb;
-    normal = normalize(normal * 2.0 - 1.0);
+    // only x and y are read: cooked normal maps are two channel BC5, z is rebuilt from the unit length
+    vec3 normal;
+    normal.xy = texture(normalMap, texCoords).rg * 2.0 - 1.0;
+    normal.z = sqrt(max(1.0 - dot(normal.xy, normal.xy), 0.0));
 
     // get diffuse color
     vec3 color = texture(diffuseMap, texCoords).rgb;
@@ -13,12 +13,10 @@ out VS_OUT {
     vec3 TangentFragPos;
 } vs_out;
 
-uniform mat4 projection;
-uniform mat4 view;
 uniform mat4 model;
 
-uniform vec3 lightPos;
-uniform vec3 viewPos;
+#include "include/frame.glsl"
+#include "include/lights.glsl"
 
 void main()
 {
@@ -30,8 +28,8 @@ void main()
     vec3 N = normalize(mat3(model) * aNormal);
     mat3 TBN = transpose(mat3(T, B, N));
 
-    vs_out.TangentLightPos = TBN * lightPos;
-    vs_out.TangentViewPos  = TBN * viewPos;
+    vs_out.TangentLightPos = TBN * pointLight.position;
+    vs_out.TangentViewPos  = TBN * viewPosition;
     vs_out.TangentFragPos  = TBN * vs_out.FragPos;
 
     gl_Position = projection * view * model * vec4(aPos, 1.0);
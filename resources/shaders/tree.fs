@@ -4,10 +4,18 @@ out vec4 FragColor;
 in vec2 TexCoords;
 
 uniform sampler2D texture1;
+// models loaded through a texture cache keep their diffuse textures in an array instead, see Material::textureArrays
+struct Material {
+    sampler2DArray texture_diffuse_array;
+};
+uniform Material material;
+uniform bool meshTextureArrays;
+uniform ivec4 meshMaterialLayers;
 
 void main()
 {
-    vec4 texColor = texture(texture1, TexCoords);
+    vec4 texColor = meshTextureArrays ? texture(material.texture_diffuse_array, vec3(TexCoords, meshMaterialLayers.x))
+                                      : texture(texture1, TexCoords);
     if(texColor.a < 0.1)
         discard;
     FragColor = texColor;
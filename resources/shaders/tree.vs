@@ -1,15 +1,22 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec2 aTexCoords;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 5) in mat4 aInstance;
 
 out vec2 TexCoords;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#include "include/frame.glsl"
+// quantized positions are stored relative to the mesh bounds, see Mesh::Draw
+uniform vec3 meshPositionOffset;
+uniform vec3 meshPositionScale;
+// instanced meshes and Model::DrawInstanced place every instance with aInstance
+uniform bool meshInstanced;
 
 void main()
 {
+    vec3 position = meshPositionOffset + aPos * meshPositionScale;
     TexCoords = aTexCoords;
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    mat4 instance = meshInstanced ? aInstance : mat4(1.0);
+    gl_Position = projection * view * model * instance * vec4(position, 1.0);
 }
\ No newline at end of file
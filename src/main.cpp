@@ -10,9 +10,16 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include <learnopengl/filesystem.h>
+#include <learnopengl/gl_ext.h>
+#include <learnopengl/gl_state.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/shader_variants.h>
+#include <learnopengl/frame_uniforms.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
+#include <learnopengl/model_loader.h>
+#include <learnopengl/render_queue.h>
+#include <learnopengl/texture_cache.h>
 
 #include <iostream>
 
@@ -28,11 +35,11 @@ void processInput(GLFWwindow *window);
 
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods);
 
-unsigned int loadTexture(char const * path, bool gammaCorrection);
+unsigned int loadTexture(TextureCache &textures, char const * path, TextureRole role);
 
-unsigned int loadCubemap(vector<std::string> faces);
+unsigned int loadCubemap(TextureStreamer &streamer, vector<std::string> faces);
 
-void renderQuad();
+unsigned int quadVertexArray();
 
 
 // settings
@@ -48,6 +55,10 @@ bool blinnKeyPressed = false;
 bool switchLight = false;
 bool switchLightKeyPressed = false;
 
+// bits of the lighting shader variants, in the order of the keys it's built with
+const unsigned int LIGHTING_BLINN = 1 << 0;
+const unsigned int LIGHTING_DOUBLE_LIGHT = 1 << 1;
+
 // translate tree
 bool translateTree = false;
 bool translateTreePressed = false;
@@ -168,12 +179,10 @@ int main() {
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    LoadGLExtensions((GLADloadproc) glfwGetProcAddress);
 
 
 
-    // tell stb_image.h to flip loaded texture's on the y-axis (before loading model).
-    stbi_set_flip_vertically_on_load(true);
-
 
     programState = new ProgramState;
     programState->LoadFromFile("resources/program_state.txt");
@@ -194,508 +203,497 @@ int main() {
     // configure global opengl state
     // -----------------------------
 
-    glEnable(GL_DEPTH_TEST);
+    glState.enable(GL_DEPTH_TEST);
 
     // Face culling
-    glEnable(GL_CULL_FACE);
-    glCullFace(GL_BACK);
+    glState.enable(GL_CULL_FACE);
+    glState.cullFace(GL_BACK);
 
     // Blending
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-
-
-
-    // bildujemo i kompajliramo sejdere
-    // -------------------------
-    Shader modelLightingShader("resources/shaders/light.vs", "resources/shaders/light.fs");
-    Shader skyboxShader("resources/shaders/skybox.vs", "resources/shaders/skybox.fs");
-    Shader treeShader("resources/shaders/tree.vs", "resources/shaders/tree.fs");
-    Shader chessFloorShader("resources/shaders/normal_mapping.vs", "resources/shaders/normal_mapping.fs");
-    Shader baseShader("resources/shaders/parallax_mapping.vs", "resources/shaders/parallax_mapping.fs");
-
-
-    //ucitavamo teksture za parallax mapping
-
-    unsigned int baseTextureDiffuse = loadTexture(FileSystem::getPath("resources/textures/ground_0010_color_2k.jpg").c_str(), true);
-    unsigned int baseTextureNormal = loadTexture(FileSystem::getPath("resources/textures/ground_0010_normal_opengl_2k.png").c_str(), true);
-    unsigned int baseTextureHeight = loadTexture(FileSystem::getPath("resources/textures/ground_0010_height_2k.png").c_str(), true);
-
-    // sejder za parallax mapping
-    baseShader.use();
-    baseShader.setInt("diffuseMap", 0);
-    baseShader.setInt("normalMap", 1);
-    baseShader.setInt("depthMap", 2);
-
-    //ucitavamo teksture za normal mapping
-
-    unsigned int floorTextureDiffuse = loadTexture(FileSystem::getPath("resources/textures/marble_0013_color_4k.jpg").c_str(), true);
-    unsigned int floorTextureNormal = loadTexture(FileSystem::getPath("resources/textures/marble_0013_normal_opengl_4k.png").c_str(), true);
-
-    // sejder za normal mapping
-    chessFloorShader.use();
-    chessFloorShader.setInt("diffuseMap", 0);
-    chessFloorShader.setInt("normalMap", 1);
-
-    unsigned  int cubeTextureDiffuse = loadTexture(FileSystem::getPath("resources/textures/marble_0013_color_4k.jpg").c_str(), true);
-
-    // ucitavamo modele
-    // -----------
-
-    Model treeModel("resources/objects/Tree/Tree.obj");
-    Model rockModel("resources/objects/79-avatar-mountain/avatar mountain.obj");
-    Model tableModel("resources/objects/picnicTable/picnic_table.obj");
-    Model chessModel("resources/objects/chess/chess.obj");
-
-    treeModel.SetShaderTextureNamePrefix("material.");
-    rockModel.SetShaderTextureNamePrefix("material.");
-    tableModel.SetShaderTextureNamePrefix("material.");
-    chessModel.SetShaderTextureNamePrefix("material.");
-
-
-    // direction svetlo
-
-    DirLight& dirLight = programState->dirLight;
-    dirLight.direction = glm::vec3( 0.0f, 40.0f, 0.0f);
-    dirLight.ambient = glm::vec3(0.05f, 0.05f, 0.05f);
-    dirLight.diffuse = glm::vec3(0.7f, 0.7f, 0.7f);
-    dirLight.specular = glm::vec3(0.9f, 0.9f, 0.9f);
-
-    // point svetlo
-
-    PointLight& pointLight = programState->pointLight;
-    pointLight.position = glm::vec3(0.0f, 12.0, 5.0);
-    pointLight.ambient = glm::vec3(0.03, 0.03, 0.03);
-    pointLight.diffuse = glm::vec3(0.6, 0.6, 0.6);
-    pointLight.specular = glm::vec3(1.0, 1.0, 1.0);
-
-    pointLight.constant = 1.0f;
-    pointLight.linear = 0.09f;
-    pointLight.quadratic = 0.032f;
-
-//    // koordinate kvadra osnove
-    float vertices[] = {
-            // back face
-            -1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 0.0f, 0.0f, // bottom-left
-            1.0f,  1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 1.0f, 1.0f, // top-right
-            1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 1.0f, 0.0f, // bottom-right
-            1.0f,  1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 1.0f, 1.0f, // top-right
-            -1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 0.0f, 0.0f, // bottom-left
-            -1.0f,  1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 0.0f, 1.0f, // top-left
-            // front face
-            -1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f, 0.0f, // bottom-left
-            1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f, 0.0f, // bottom-right
-            1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f, 1.0f, // top-right
-            1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f, 1.0f, // top-right
-            -1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f, 1.0f, // top-left
-            -1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f, 0.0f, // bottom-left
-            // left face
-            -1.0f,  1.0f,  1.0f, -1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-right
-            -1.0f,  1.0f, -1.0f, -1.0f,  0.0f,  0.0f, 1.0f, 1.0f, // top-left
-            -1.0f, -1.0f, -1.0f, -1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-left
-            -1.0f, -1.0f, -1.0f, -1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-left
-            -1.0f, -1.0f,  1.0f, -1.0f,  0.0f,  0.0f, 0.0f, 0.0f, // bottom-right
-            -1.0f,  1.0f,  1.0f, -1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-right
-            // right face
-            1.0f,  1.0f,  1.0f,  1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-left
-            1.0f, -1.0f, -1.0f,  1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-right
-            1.0f,  1.0f, -1.0f,  1.0f,  0.0f,  0.0f, 1.0f, 1.0f, // top-right
-            1.0f, -1.0f, -1.0f,  1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-right
-            1.0f,  1.0f,  1.0f,  1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-left
-            1.0f, -1.0f,  1.0f,  1.0f,  0.0f,  0.0f, 0.0f, 0.0f, // bottom-left
-            // bottom face
-            -1.0f, -1.0f, -1.0f,  0.0f, -1.0f,  0.0f, 0.0f, 1.0f, // top-right
-            1.0f, -1.0f, -1.0f,  0.0f, -1.0f,  0.0f, 1.0f, 1.0f, // top-left
-            1.0f, -1.0f,  1.0f,  0.0f, -1.0f,  0.0f, 1.0f, 0.0f, // bottom-left
-            1.0f, -1.0f,  1.0f,  0.0f, -1.0f,  0.0f, 1.0f, 0.0f, // bottom-left
-            -1.0f, -1.0f,  1.0f,  0.0f, -1.0f,  0.0f, 0.0f, 0.0f, // bottom-right
-            -1.0f, -1.0f, -1.0f,  0.0f, -1.0f,  0.0f, 0.0f, 1.0f, // top-right
-            // top face
-            -1.0f,  1.0f, -1.0f,  0.0f,  1.0f,  0.0f, 0.0f, 1.0f, // top-left
-            1.0f,  1.0f , 1.0f,  0.0f,  1.0f,  0.0f, 1.0f, 0.0f, // bottom-right
-            1.0f,  1.0f, -1.0f,  0.0f,  1.0f,  0.0f, 1.0f, 1.0f, // top-right
-            1.0f,  1.0f,  1.0f,  0.0f,  1.0f,  0.0f, 1.0f, 0.0f, // bottom-right
-            -1.0f,  1.0f, -1.0f,  0.0f,  1.0f,  0.0f, 0.0f, 1.0f, // top-left
-            -1.0f,  1.0f,  1.0f,  0.0f,  1.0f,  0.0f, 0.0f, 0.0f  // bottom-left
-    };
-
-
-
-   // skybox cube vertices
-
-    float skyboxVertices[] = {
-            // positions
-            -1.0f,  1.0f, -1.0f,
-            -1.0f, -1.0f, -1.0f,
-            1.0f, -1.0f, -1.0f,
-            1.0f, -1.0f, -1.0f,
-            1.0f,  1.0f, -1.0f,
-            -1.0f,  1.0f, -1.0f,
-
-            -1.0f, -1.0f,  1.0f,
-            -1.0f, -1.0f, -1.0f,
-            -1.0f,  1.0f, -1.0f,
-            -1.0f,  1.0f, -1.0f,
-            -1.0f,  1.0f,  1.0f,
-            -1.0f, -1.0f,  1.0f,
-
-            1.0f, -1.0f, -1.0f,
-            1.0f, -1.0f,  1.0f,
-            1.0f,  1.0f,  1.0f,
-            1.0f,  1.0f,  1.0f,
-            1.0f,  1.0f, -1.0f,
-            1.0f, -1.0f, -1.0f,
-
-            -1.0f, -1.0f,  1.0f,
-            -1.0f,  1.0f,  1.0f,
-            1.0f,  1.0f,  1.0f,
-            1.0f,  1.0f,  1.0f,
-            1.0f, -1.0f,  1.0f,
-            -1.0f, -1.0f,  1.0f,
-
-            -1.0f,  1.0f, -1.0f,
-            1.0f,  1.0f, -1.0f,
-            1.0f,  1.0f,  1.0f,
-            1.0f,  1.0f,  1.0f,
-            -1.0f,  1.0f,  1.0f,
-            -1.0f,  1.0f, -1.0f,
-
-            -1.0f, -1.0f, -1.0f,
-            -1.0f, -1.0f,  1.0f,
-            1.0f, -1.0f, -1.0f,
-            1.0f, -1.0f, -1.0f,
-            -1.0f, -1.0f,  1.0f,
-            1.0f, -1.0f,  1.0f
-    };
-
-    // skybox VAO
-    unsigned int skyboxVAO, skyboxVBO;
-    glGenVertexArrays(1, &skyboxVAO);
-    glGenBuffers(1, &skyboxVBO);
-    glBindVertexArray(skyboxVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-
-    stbi_set_flip_vertically_on_load(false);
-
-    vector<std::string> faces
-            {
-                    FileSystem::getPath("resources/textures/skybox/right.jpg"),
-                    FileSystem::getPath("resources/textures/skybox/left.jpg"),
-                    FileSystem::getPath("resources/textures/skybox/top.jpg"),
-                    FileSystem::getPath("resources/textures/skybox/bottom.jpg"),
-                    FileSystem::getPath("resources/textures/skybox/front.jpg"),
-                    FileSystem::getPath("resources/textures/skybox/back.jpg")
-            };
-    unsigned int cubemapTexture = loadCubemap(faces);
-
-    skyboxShader.use();
-    skyboxShader.setInt("skybox", 0);
-
-
-    // draw in wireframe
-    //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-
-    // render loop
-    // -----------
-    while (!glfwWindowShouldClose(window)) {
-        // per-frame time logic
-        // --------------------
-        float currentFrame = glfwGetTime();
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
-
-        // input
-        // -----
-        processInput(window);
-
-
-        // render
-        // ------
-        glClearColor(programState->clearColor.r, programState->clearColor.g, programState->clearColor.b, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glState.enable(GL_BLEND);
+    glState.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-        // don't forget to enable shader before setting uniforms
-        modelLightingShader.use();
 
-        modelLightingShader.setVec3("dirLight.direction", dirLight.direction);
-        modelLightingShader.setVec3("dirLight.ambient", dirLight.ambient);
-        modelLightingShader.setVec3("dirLight.diffuse", dirLight.diffuse);
-        modelLightingShader.setVec3("dirLight.specular", dirLight.specular);
-
-        modelLightingShader.setVec3("pointLight.position", pointLight.position);
-        modelLightingShader.setVec3("pointLight.ambient", pointLight.ambient);
-        modelLightingShader.setVec3("pointLight.diffuse", pointLight.diffuse);
-        modelLightingShader.setVec3("pointLight.specular", pointLight.specular);
-        modelLightingShader.setFloat("pointLight.constant", pointLight.constant);
-        modelLightingShader.setFloat("pointLight.linear", pointLight.linear);
-        modelLightingShader.setFloat("pointLight.quadratic", pointLight.quadratic);
-        modelLightingShader.setVec3("viewPosition", programState->camera.Position);
-        modelLightingShader.setFloat("material.shininess", 32.0f);
-        modelLightingShader.setInt("blinn", blinn);
-        modelLightingShader.setInt("switchLight", switchLight);
 
 
+    // everything below owns GL objects and deletes them when it goes out of scope, which has to happen while the
+    // context is still current: the block closes before ImGui shuts down and glfwTerminate() destroys it
+    {
+        // pokrecemo ucitavanje modela
+        // -----------
+        // Assimp and texture decoding run on the worker threads while this thread compiles shaders and loads textures
+        ThreadPool workers;
+        // textures start out as 1x1 placeholders and are decoded on the workers, see TextureStreamer
+        TextureStreamer textureStreamer(workers);
+        // shared by the models and the textures below, an image used twice is only decoded and uploaded once
+        TextureCache textureCache(textureStreamer);
+        // every model's vertices and indices share a few buffers, see GeometryArena
+        GeometryArena geometry;
+        ModelLoader modelLoader(workers, &textureCache, &geometry);
+        Model treeModel, rockModel, tableModel, chessModel;
+        modelLoader.load(treeModel, "resources/objects/Tree/Tree.obj");
+        modelLoader.load(rockModel, "resources/objects/79-avatar-mountain/avatar mountain.obj");
+        modelLoader.load(tableModel, "resources/objects/picnicTable/picnic_table.obj");
+        // 70 groups but only three distinct materials and many repeated pieces, and the board is drawn four times
+        modelLoader.load(chessModel, "resources/objects/chess/chess.obj", MODEL_IMPORT_INSTANCE_DUPLICATES | MODEL_IMPORT_MERGE_BY_MATERIAL);
+
+
+        // bildujemo i kompajliramo sejdere
+        // -------------------------
+        // all programs are submitted at once and the driver compiles them while the textures below are queued
+        ShaderBatch shaderBatch;
+        ShaderVariants modelLightingShaders(shaderBatch, "resources/shaders/light.vs", "resources/shaders/light.fs", {"BLINN", "DOUBLE_LIGHT"});
+        Shader skyboxShader(shaderBatch, "resources/shaders/skybox.vs", "resources/shaders/skybox.fs");
+        Shader treeShader(shaderBatch, "resources/shaders/tree.vs", "resources/shaders/tree.fs");
+        Shader chessFloorShader(shaderBatch, "resources/shaders/normal_mapping.vs", "resources/shaders/normal_mapping.fs");
+        Shader baseShader(shaderBatch, "resources/shaders/parallax_mapping.vs", "resources/shaders/parallax_mapping.fs");
+
+        // upload whatever the workers have finished so far
+        modelLoader.uploadFinished();
+
+
+        //ucitavamo teksture za parallax mapping
+
+        unsigned int baseTextureDiffuse = loadTexture(textureCache, FileSystem::getPath("resources/textures/ground_0010_color_2k.jpg").c_str(), TextureRole::Albedo);
+        unsigned int baseTextureNormal = loadTexture(textureCache, FileSystem::getPath("resources/textures/ground_0010_normal_opengl_2k.png").c_str(), TextureRole::Normal);
+        unsigned int baseTextureHeight = loadTexture(textureCache, FileSystem::getPath("resources/textures/ground_0010_height_2k.png").c_str(), TextureRole::Height);
+
+        //ucitavamo teksture za normal mapping
+
+        unsigned int floorTextureDiffuse = loadTexture(textureCache, FileSystem::getPath("resources/textures/marble_0013_color_4k.jpg").c_str(), TextureRole::Albedo);
+        unsigned int floorTextureNormal = loadTexture(textureCache, FileSystem::getPath("resources/textures/marble_0013_normal_opengl_4k.png").c_str(), TextureRole::Normal);
+
+        unsigned  int cubeTextureDiffuse = loadTexture(textureCache, FileSystem::getPath("resources/textures/marble_0013_color_4k.jpg").c_str(), TextureRole::Albedo);
+
+        // the shaders are needed from here on
+        shaderBatch.finish();
+        ProgramCache::report();
+
+        // sejder za parallax mapping
+        baseShader.use();
+        baseShader.setInt("diffuseMap", 0);
+        baseShader.setInt("normalMap", 1);
+        baseShader.setInt("depthMap", 2);
 
-        // view/projection transformations
-        glm::mat4 projection = glm::perspective(glm::radians(programState->camera.Zoom),
-                                                (float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f, 100.0f);
-        glm::mat4 view = programState->camera.GetViewMatrix();
-        modelLightingShader.setMat4("projection", projection);
-        modelLightingShader.setMat4("view", view);
+        // sejder za normal mapping
+        chessFloorShader.use();
+        chessFloorShader.setInt("diffuseMap", 0);
+        chessFloorShader.setInt("normalMap", 1);
+
+        // ucitavamo modele
+        // -----------
+
+        // the imports were queued before the shaders; wait for the remaining ones and upload them
+        modelLoader.finish();
+        textureCache.report();
+        geometry.report();
+
+        treeModel.SetShaderTextureNamePrefix("material.");
+        rockModel.SetShaderTextureNamePrefix("material.");
+        tableModel.SetShaderTextureNamePrefix("material.");
+        chessModel.SetShaderTextureNamePrefix("material.");
+
+        // uniforms the render loop sets every frame, resolved once instead of looked up by name on every set. the model
+        // matrices are set by the render queue
+        Uniform<float> baseHeightScale = baseShader.uniform<float>("heightScale");
+
+        // the textures of the geometry main draws itself, as materials so the render queue can sort by them. the quads
+        // and the sky read their own sampler names, set above, so only the units count
+        Material baseMaterial = Material::FromTextures({{baseTextureDiffuse, "texture_diffuse", ""},
+                                                        {baseTextureNormal, "texture_normal", ""},
+                                                        {baseTextureHeight, "texture_height", ""}});
+        Material floorMaterial = Material::FromTextures({{floorTextureDiffuse, "texture_diffuse", ""},
+                                                         {floorTextureNormal, "texture_normal", ""}});
+        // the cube reads its specular intensity from the diffuse texture, like the models without a specular map
+        Material cubeMaterial = Material::FromTextures({{cubeTextureDiffuse, "texture_diffuse", ""},
+                                                        {cubeTextureDiffuse, "texture_specular", ""}});
+
+        // camera and lights every shader reads, uploaded once per frame instead of once per shader
+        UniformRing<FrameBlock> frameUniforms(FRAME_UNIFORM_BINDING);
+        UniformRing<LightingBlock> lightingUniforms(LIGHTING_UNIFORM_BINDING);
+
+        // direction svetlo
+
+        DirLight& dirLight = programState->dirLight;
+        dirLight.direction = glm::vec3( 0.0f, 40.0f, 0.0f);
+        dirLight.ambient = glm::vec3(0.05f, 0.05f, 0.05f);
+        dirLight.diffuse = glm::vec3(0.7f, 0.7f, 0.7f);
+        dirLight.specular = glm::vec3(0.9f, 0.9f, 0.9f);
+
+        // point svetlo
+
+        PointLight& pointLight = programState->pointLight;
+        pointLight.position = glm::vec3(0.0f, 12.0, 5.0);
+        pointLight.ambient = glm::vec3(0.03, 0.03, 0.03);
+        pointLight.diffuse = glm::vec3(0.6, 0.6, 0.6);
+        pointLight.specular = glm::vec3(1.0, 1.0, 1.0);
+
+        pointLight.constant = 1.0f;
+        pointLight.linear = 0.09f;
+        pointLight.quadratic = 0.032f;
+
+    //    // koordinate kvadra osnove
+        float vertices[] = {
+                // back face
+                -1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 0.0f, 0.0f, // bottom-left
+                1.0f,  1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 1.0f, 1.0f, // top-right
+                1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 1.0f, 0.0f, // bottom-right
+                1.0f,  1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 1.0f, 1.0f, // top-right
+                -1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 0.0f, 0.0f, // bottom-left
+                -1.0f,  1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 0.0f, 1.0f, // top-left
+                // front face
+                -1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f, 0.0f, // bottom-left
+                1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f, 0.0f, // bottom-right
+                1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f, 1.0f, // top-right
+                1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f, 1.0f, // top-right
+                -1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f, 1.0f, // top-left
+                -1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f, 0.0f, // bottom-left
+                // left face
+                -1.0f,  1.0f,  1.0f, -1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-right
+                -1.0f,  1.0f, -1.0f, -1.0f,  0.0f,  0.0f, 1.0f, 1.0f, // top-left
+                -1.0f, -1.0f, -1.0f, -1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-left
+                -1.0f, -1.0f, -1.0f, -1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-left
+                -1.0f, -1.0f,  1.0f, -1.0f,  0.0f,  0.0f, 0.0f, 0.0f, // bottom-right
+                -1.0f,  1.0f,  1.0f, -1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-right
+                // right face
+                1.0f,  1.0f,  1.0f,  1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-left
+                1.0f, -1.0f, -1.0f,  1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-right
+                1.0f,  1.0f, -1.0f,  1.0f,  0.0f,  0.0f, 1.0f, 1.0f, // top-right
+                1.0f, -1.0f, -1.0f,  1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-right
+                1.0f,  1.0f,  1.0f,  1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-left
+                1.0f, -1.0f,  1.0f,  1.0f,  0.0f,  0.0f, 0.0f, 0.0f, // bottom-left
+                // bottom face
+                -1.0f, -1.0f, -1.0f,  0.0f, -1.0f,  0.0f, 0.0f, 1.0f, // top-right
+                1.0f, -1.0f, -1.0f,  0.0f, -1.0f,  0.0f, 1.0f, 1.0f, // top-left
+                1.0f, -1.0f,  1.0f,  0.0f, -1.0f,  0.0f, 1.0f, 0.0f, // bottom-left
+                1.0f, -1.0f,  1.0f,  0.0f, -1.0f,  0.0f, 1.0f, 0.0f, // bottom-left
+                -1.0f, -1.0f,  1.0f,  0.0f, -1.0f,  0.0f, 0.0f, 0.0f, // bottom-right
+                -1.0f, -1.0f, -1.0f,  0.0f, -1.0f,  0.0f, 0.0f, 1.0f, // top-right
+                // top face
+                -1.0f,  1.0f, -1.0f,  0.0f,  1.0f,  0.0f, 0.0f, 1.0f, // top-left
+                1.0f,  1.0f , 1.0f,  0.0f,  1.0f,  0.0f, 1.0f, 0.0f, // bottom-right
+                1.0f,  1.0f, -1.0f,  0.0f,  1.0f,  0.0f, 1.0f, 1.0f, // top-right
+                1.0f,  1.0f,  1.0f,  0.0f,  1.0f,  0.0f, 1.0f, 0.0f, // bottom-right
+                -1.0f,  1.0f, -1.0f,  0.0f,  1.0f,  0.0f, 0.0f, 1.0f, // top-left
+                -1.0f,  1.0f,  1.0f,  0.0f,  1.0f,  0.0f, 0.0f, 0.0f  // bottom-left
+        };
 
 
-        // renderujemo ucitane modele
 
+       // skybox cube vertices
+
+        float skyboxVertices[] = {
+                // positions
+                -1.0f,  1.0f, -1.0f,
+                -1.0f, -1.0f, -1.0f,
+                1.0f, -1.0f, -1.0f,
+                1.0f, -1.0f, -1.0f,
+                1.0f,  1.0f, -1.0f,
+                -1.0f,  1.0f, -1.0f,
+
+                -1.0f, -1.0f,  1.0f,
+                -1.0f, -1.0f, -1.0f,
+                -1.0f,  1.0f, -1.0f,
+                -1.0f,  1.0f, -1.0f,
+                -1.0f,  1.0f,  1.0f,
+                -1.0f, -1.0f,  1.0f,
+
+                1.0f, -1.0f, -1.0f,
+                1.0f, -1.0f,  1.0f,
+                1.0f,  1.0f,  1.0f,
+                1.0f,  1.0f,  1.0f,
+                1.0f,  1.0f, -1.0f,
+                1.0f, -1.0f, -1.0f,
+
+                -1.0f, -1.0f,  1.0f,
+                -1.0f,  1.0f,  1.0f,
+                1.0f,  1.0f,  1.0f,
+                1.0f,  1.0f,  1.0f,
+                1.0f, -1.0f,  1.0f,
+                -1.0f, -1.0f,  1.0f,
+
+                -1.0f,  1.0f, -1.0f,
+                1.0f,  1.0f, -1.0f,
+                1.0f,  1.0f,  1.0f,
+                1.0f,  1.0f,  1.0f,
+                -1.0f,  1.0f,  1.0f,
+                -1.0f,  1.0f, -1.0f,
+
+                -1.0f, -1.0f, -1.0f,
+                -1.0f, -1.0f,  1.0f,
+                1.0f, -1.0f, -1.0f,
+                1.0f, -1.0f, -1.0f,
+                -1.0f, -1.0f,  1.0f,
+                1.0f, -1.0f,  1.0f
+        };
 
+        // skybox VAO
+        unsigned int skyboxVAO, skyboxVBO;
+        glGenVertexArrays(1, &skyboxVAO);
+        glGenBuffers(1, &skyboxVBO);
+        glState.bindVertexArray(skyboxVAO);
+        glState.bindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+        glState.bindVertexArray(0);
+
+        vector<std::string> faces
+                {
+                        FileSystem::getPath("resources/textures/skybox/right.jpg"),
+                        FileSystem::getPath("resources/textures/skybox/left.jpg"),
+                        FileSystem::getPath("resources/textures/skybox/top.jpg"),
+                        FileSystem::getPath("resources/textures/skybox/bottom.jpg"),
+                        FileSystem::getPath("resources/textures/skybox/front.jpg"),
+                        FileSystem::getPath("resources/textures/skybox/back.jpg")
+                };
+        unsigned int cubemapTexture = loadCubemap(textureStreamer, faces);
 
-        // modeli stolova i table za sah
+        skyboxShader.use();
+        skyboxShader.setInt("skybox", 0);
 
+        Material skyboxMaterial;
+        skyboxMaterial.textures.push_back({GL_TEXTURE_CUBE_MAP, cubemapTexture, 0, 0, -1});
 
-        float diffZ = -30.0f;
-        for(int i = 0; i < 2; i++)
+        // kvadar osnove, uploaded once like a model mesh so it shares the arena's vertex array and the lighting shader's
+        // position decoding
+        MeshData cubeData;
+        for (unsigned int i = 0; i < 36; i++)
         {
-            diffZ += 20.0f;
-            glm::mat4 model_mat_table = glm::mat4(1.0f);
-            model_mat_table = glm::translate(model_mat_table,
-                                    glm::vec3 (10.0f, 0.0f, diffZ));
-            model_mat_table = glm::scale(model_mat_table, glm::vec3(6.0f));
-            modelLightingShader.setMat4("model", model_mat_table);
-            tableModel.Draw(modelLightingShader);
-
-            glm::mat4 model_mat_chess = glm::mat4(1.0f);
-            model_mat_chess = glm::translate(model_mat_chess,
-                                     glm::vec3 (10.0f, 4.8f, diffZ));
-            model_mat_chess = glm::scale(model_mat_chess, glm::vec3(1.5f));
-            modelLightingShader.setMat4("model", model_mat_chess);
-            chessModel.Draw(modelLightingShader);
+            Vertex vertex = {};
+            vertex.Position = glm::vec3(vertices[i * 8], vertices[i * 8 + 1], vertices[i * 8 + 2]);
+            vertex.Normal = glm::vec3(vertices[i * 8 + 3], vertices[i * 8 + 4], vertices[i * 8 + 5]);
+            vertex.TexCoords = glm::vec2(vertices[i * 8 + 6], vertices[i * 8 + 7]);
+            cubeData.vertices.push_back(vertex);
+            cubeData.indices.push_back(i);
         }
-
-        // modeli stolova i table za sah
-
-        diffZ = -30.0f;
-        for(int i = 0; i < 2; i++)
+        cubeData.computeBounds();
+        Mesh cubeMesh = MeshUploader::upload(cubeData, &cubeMaterial, VertexLayout::Compact, &geometry);
+        cubeMesh.glslIdentifierPrefix = "material.";
+
+        // podloga sa teksturom sahovskog polja: the normal mapped quad of quadVertexArray(), with the tangents it works
+        // out, as a one mesh model so all boards are one instanced draw. float vertices, normal_mapping.vs takes the
+        // positions as they are and reads the bitangents
+        MeshData boardData;
+        const glm::vec3 boardPositions[] = {{-1.0f, 1.0f, 0.0f}, {-1.0f, -1.0f, 0.0f}, {1.0f, -1.0f, 0.0f}, {1.0f, 1.0f, 0.0f}};
+        const glm::vec2 boardTexCoords[] = {{0.0f, 1.0f}, {0.0f, 0.0f}, {1.0f, 0.0f}, {1.0f, 1.0f}};
+        for (unsigned int i = 0; i < 4; i++)
         {
-            diffZ += 20.0f;
-            glm::mat4 model_mat_table = glm::mat4(1.0f);
-            model_mat_table = glm::translate(model_mat_table,
-                                    glm::vec3 (-10.0f, 0.0f, diffZ));
-            model_mat_table = glm::scale(model_mat_table, glm::vec3(6.0f));
-            modelLightingShader.setMat4("model", model_mat_table);
-            tableModel.Draw(modelLightingShader);
-
-            glm::mat4 model_mat_chess = glm::mat4(1.0f);
-            model_mat_chess = glm::translate(model_mat_chess,
-                                     glm::vec3 (-10.0f, 4.8f, diffZ));
-            model_mat_chess = glm::scale(model_mat_chess, glm::vec3(1.5f));
-            modelLightingShader.setMat4("model", model_mat_chess);
-            chessModel.Draw(modelLightingShader);
+            Vertex vertex = {};
+            vertex.Position = boardPositions[i];
+            vertex.Normal = glm::vec3(0.0f, 0.0f, 1.0f);
+            vertex.TexCoords = boardTexCoords[i];
+            vertex.Tangent = glm::vec3(1.0f, 0.0f, 0.0f);
+            vertex.Bitangent = glm::vec3(0.0f, 1.0f, 0.0f);
+            boardData.vertices.push_back(vertex);
+        }
+        boardData.indices = {0, 1, 2, 0, 2, 3};
+        boardData.computeBounds();
+        Model boardModel;
+        boardModel.vertexLayout = VertexLayout::Float;
+        boardModel.meshes.push_back(MeshUploader::upload(boardData, &floorMaterial, VertexLayout::Float, &geometry));
+
+        // stolovi, table za sah i podloge at x = +-10, z = -10 / +10. each set is drawn instanced, so more tables are
+        // more instances of the same draws
+        vector<glm::mat4> tableTransforms, chessTransforms, boardTransforms;
+        for (float x : {10.0f, -10.0f}) {
+            for (float z : {-10.0f, 10.0f}) {
+                tableTransforms.push_back(glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(x, 0.0f, z)), glm::vec3(6.0f)));
+                chessTransforms.push_back(glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(x, 4.8f, z)), glm::vec3(1.5f)));
+                glm::mat4 board = glm::translate(glm::mat4(1.0f), glm::vec3(x, 0.1f, z));
+                board = glm::rotate(board, float(-1.5708f), glm::vec3(1.0f, 0.0f, 0.0f));
+                boardTransforms.push_back(glm::scale(board, glm::vec3(8.0f)));
+            }
         }
 
-        //model drveta
+        // every draw of a frame goes through here, sorted so programs, materials and vertex arrays change as rarely as
+        // possible
+        RenderQueue renderQueue;
 
 
-        treeShader.use();
-        treeShader.setMat4("projection", projection);
-        treeShader.setMat4("view", view);
+        // draw in wireframe
+        //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
+        // render loop
+        // -----------
+        bool firstFrame = true;
+        while (!glfwWindowShouldClose(window)) {
+            // per-frame time logic
+            // --------------------
+            float currentFrame = glfwGetTime();
+            deltaTime = currentFrame - lastFrame;
+            lastFrame = currentFrame;
 
-        glm::mat4 model_mat_tree_u = glm::mat4(1.0f);
-        if(translateTree == false)
-        {
-            model_mat_tree_u = glm::translate(model_mat_tree_u, glm::vec3(20*sin(glfwGetTime()), 4.0f, -23.0f));
+            // swap in the textures the workers have decoded since the last frame
+            textureStreamer.update();
 
-        } else {
-            model_mat_tree_u = glm::translate(model_mat_tree_u, glm::vec3(0.0f, 4.0f, -23.0f));
-        }
+            // input
+            // -----
+            processInput(window);
 
-        model_mat_tree_u = glm::rotate(model_mat_tree_u, (float)(sin(glfwGetTime())), glm::vec3(0.0f, 1.0f, 0.0f));
-        model_mat_tree_u = glm::scale(model_mat_tree_u, glm::vec3(4.0f));
-        treeShader.setMat4("model", model_mat_tree_u);
-        treeModel.Draw(treeShader);
 
-        glm::mat4 model_mat_tree_d = glm::mat4(1.0f);
-        if(translateTree == false)
-        {
-            model_mat_tree_d = glm::translate(model_mat_tree_d, glm::vec3(-20*sin(glfwGetTime()), 4.0f, 23.0f));
-
-        } else {
-            model_mat_tree_d = glm::translate(model_mat_tree_d, glm::vec3(0.0f, 4.0f, 23.0f));
-        }
+            // render
+            // ------
+            glClearColor(programState->clearColor.r, programState->clearColor.g, programState->clearColor.b, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        model_mat_tree_d = glm::rotate(model_mat_tree_d, (float)(sin(glfwGetTime())), glm::vec3(0.0f, 1.0f, 0.0f));
-        model_mat_tree_d = glm::scale(model_mat_tree_d, glm::vec3(4.0f));
-        treeShader.setMat4("model", model_mat_tree_d);
-        treeModel.Draw(treeShader);
+            // view/projection transformations
+            glm::mat4 projection = glm::perspective(glm::radians(programState->camera.Zoom),
+                                                    (float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f, 100.0f);
+            glm::mat4 view = programState->camera.GetViewMatrix();
 
-        // model stena
+            FrameBlock frame = {};
+            frame.projection = projection;
+            frame.view = view;
+            frame.viewPosition = programState->camera.Position;
+            frame.time = currentFrame;
+            frameUniforms.write(frame);
 
-        modelLightingShader.use();
+            LightingBlock lighting = {};
+            lighting.dirLight.direction = dirLight.direction;
+            lighting.dirLight.ambient = dirLight.ambient;
+            lighting.dirLight.diffuse = dirLight.diffuse;
+            lighting.dirLight.specular = dirLight.specular;
+            lighting.pointLight.position = pointLight.position;
+            lighting.pointLight.ambient = pointLight.ambient;
+            lighting.pointLight.diffuse = pointLight.diffuse;
+            lighting.pointLight.specular = pointLight.specular;
+            lighting.pointLight.constant = pointLight.constant;
+            lighting.pointLight.linear = pointLight.linear;
+            lighting.pointLight.quadratic = pointLight.quadratic;
+            lightingUniforms.write(lighting);
 
-        glm::mat4 model_mat_rock_u = glm::mat4(1.0f);
-        if(translateTree == false)
-        {
-            model_mat_rock_u = glm::translate(model_mat_rock_u, glm::vec3(20*sin(glfwGetTime()), 4.0f, -23.0f));
-        }else{
-            model_mat_rock_u = glm::translate(model_mat_rock_u, glm::vec3(0.0f, 3.0f, -23.0f));
-        }
+            // the B and L toggles pick the variant compiled for them
+            unsigned int lightingVariant = (blinn ? LIGHTING_BLINN : 0) | (switchLight ? LIGHTING_DOUBLE_LIGHT : 0);
+            Shader &modelLightingShader = modelLightingShaders.variant(lightingVariant);
 
-        model_mat_rock_u = glm::rotate(model_mat_rock_u, (float)(sin(glfwGetTime())), glm::vec3(0.0f, 1.0f, 0.0f));
-        model_mat_rock_u = glm::scale(model_mat_rock_u, glm::vec3(2.0f));
-        modelLightingShader.setMat4("model", model_mat_rock_u);
-        rockModel.Draw(modelLightingShader);
+            // the draws below are only queued, renderQueue.execute() runs them sorted by shader, material and vertex array
+            renderQueue.begin(view, 0.1f, 100.0f);
 
 
+            // renderujemo ucitane modele
 
-        glm::mat4 model_mat_rock_d = glm::mat4(1.0f);
-        if(translateTree == false)
-        {
-            model_mat_rock_d = glm::translate(model_mat_rock_d, glm::vec3(-20*sin(glfwGetTime()), 4.0f, 23.0f));
-        }else{
-            model_mat_rock_d = glm::translate(model_mat_rock_d, glm::vec3(0.0f, 3.0f, 23.0f));
-        }
 
-        model_mat_rock_d = glm::rotate(model_mat_rock_d, (float)(sin(glfwGetTime())), glm::vec3(0.0f, 1.0f, 0.0f));
-        model_mat_rock_d = glm::scale(model_mat_rock_d, glm::vec3(2.0f));
-        modelLightingShader.setMat4("model", model_mat_rock_d);
-        rockModel.Draw(modelLightingShader);
 
+            // modeli stolova i table za sah
 
-        //kvadar osnove  (parallax mapping)
+            renderQueue.submitIndirectInstanced(tableModel, modelLightingShader, tableTransforms);
+            renderQueue.submitIndirectInstanced(chessModel, modelLightingShader, chessTransforms);
 
+            //model drveta
 
-        // aktiviramo i vezujemo teksture
 
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, baseTextureDiffuse);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, baseTextureNormal);
-        glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, baseTextureHeight);
+            glm::mat4 model_mat_tree_u = glm::mat4(1.0f);
+            if(translateTree == false)
+            {
+                model_mat_tree_u = glm::translate(model_mat_tree_u, glm::vec3(20*sin(glfwGetTime()), 4.0f, -23.0f));
 
+            } else {
+                model_mat_tree_u = glm::translate(model_mat_tree_u, glm::vec3(0.0f, 4.0f, -23.0f));
+            }
 
-        baseShader.use();
+            model_mat_tree_u = glm::rotate(model_mat_tree_u, (float)(sin(glfwGetTime())), glm::vec3(0.0f, 1.0f, 0.0f));
+            model_mat_tree_u = glm::scale(model_mat_tree_u, glm::vec3(4.0f));
 
-        baseShader.setMat4("projection", projection);
-        baseShader.setMat4("view", view);
-        baseShader.setVec3("viewPos", programState->camera.Position);
-        baseShader.setVec3("lightPos", pointLight.position);
-        baseShader.setFloat("heightScale", heightScale);
+            glm::mat4 model_mat_tree_d = glm::mat4(1.0f);
+            if(translateTree == false)
+            {
+                model_mat_tree_d = glm::translate(model_mat_tree_d, glm::vec3(-20*sin(glfwGetTime()), 4.0f, 23.0f));
 
+            } else {
+                model_mat_tree_d = glm::translate(model_mat_tree_d, glm::vec3(0.0f, 4.0f, 23.0f));
+            }
 
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(0.0f, 0.0f, 0.0f));
-        model = glm::rotate(model, float(-1.5708f),glm::vec3(1.0f, 0.0f, 0.0f));
-        model = glm::scale(model, glm::vec3(20.0f));
-        baseShader.setMat4("model", model);
-        renderQuad();
+            model_mat_tree_d = glm::rotate(model_mat_tree_d, (float)(sin(glfwGetTime())), glm::vec3(0.0f, 1.0f, 0.0f));
+            model_mat_tree_d = glm::scale(model_mat_tree_d, glm::vec3(4.0f));
+            const glm::mat4 treeTransforms[] = {model_mat_tree_u, model_mat_tree_d};
+            renderQueue.submitInstanced(treeModel, treeShader, treeTransforms, 2);
 
+            // model stena
 
-        // kvadar osnove
+            glm::mat4 model_mat_rock_u = glm::mat4(1.0f);
+            if(translateTree == false)
+            {
+                model_mat_rock_u = glm::translate(model_mat_rock_u, glm::vec3(20*sin(glfwGetTime()), 4.0f, -23.0f));
+            }else{
+                model_mat_rock_u = glm::translate(model_mat_rock_u, glm::vec3(0.0f, 3.0f, -23.0f));
+            }
 
-        modelLightingShader.use();
+            model_mat_rock_u = glm::rotate(model_mat_rock_u, (float)(sin(glfwGetTime())), glm::vec3(0.0f, 1.0f, 0.0f));
+            model_mat_rock_u = glm::scale(model_mat_rock_u, glm::vec3(2.0f));
 
-        glm::mat4 model_cube = glm::mat4(1.0f);
-        model_cube = glm::translate(model_cube, glm::vec3(0.0f, -0.32f, 0.0f));
-        model_cube = glm::scale(model_cube, glm::vec3(20.0f, 0.3f, 20.0f));
-        modelLightingShader.setMat4("model", model_cube);
 
-        unsigned int cubeVAO = 0;
-        unsigned int cubeVBO = 0;
 
-        glGenVertexArrays(1, &cubeVAO);
-        glGenBuffers(1, &cubeVBO);
-        // saljemo podatke na bafer objekat
-        glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-        // link vertex atributi
-        glBindVertexArray(cubeVAO);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindVertexArray(0);
-
-        // renderujemo kvadar
-        glBindVertexArray(cubeVAO);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
+            glm::mat4 model_mat_rock_d = glm::mat4(1.0f);
+            if(translateTree == false)
+            {
+                model_mat_rock_d = glm::translate(model_mat_rock_d, glm::vec3(-20*sin(glfwGetTime()), 4.0f, 23.0f));
+            }else{
+                model_mat_rock_d = glm::translate(model_mat_rock_d, glm::vec3(0.0f, 3.0f, 23.0f));
+            }
 
+            model_mat_rock_d = glm::rotate(model_mat_rock_d, (float)(sin(glfwGetTime())), glm::vec3(0.0f, 1.0f, 0.0f));
+            model_mat_rock_d = glm::scale(model_mat_rock_d, glm::vec3(2.0f));
+            const glm::mat4 rockTransforms[] = {model_mat_rock_u, model_mat_rock_d};
+            renderQueue.submitIndirectInstanced(rockModel, modelLightingShader, rockTransforms, 2);
 
-        // vezujemo teksturu za podlogu sa teksturom sahovskog polja
 
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, floorTextureDiffuse);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, floorTextureNormal);
+            //kvadar osnove  (parallax mapping)
 
-        // sejder za podlogu sa teksturom sahovskog polja (implementiran normal mapping)
 
-        chessFloorShader.use();
-        chessFloorShader.setMat4("projection", projection);
-        chessFloorShader.setMat4("view", view);
-        chessFloorShader.setVec3("viewPos", programState->camera.Position);
-        chessFloorShader.setVec3("lightPos", pointLight.position);
+            baseShader.use();
 
+            baseHeightScale.set(heightScale);
 
-        diffZ = -30.0f;
 
-        for(int i = 0; i < 2; i++){
-            diffZ += 20.0f;
             glm::mat4 model = glm::mat4(1.0f);
-            model = glm::translate(model, glm::vec3(10.0f, 0.1f, diffZ));
+            model = glm::translate(model, glm::vec3(0.0f, 0.0f, 0.0f));
             model = glm::rotate(model, float(-1.5708f),glm::vec3(1.0f, 0.0f, 0.0f));
-            model = glm::scale(model, glm::vec3(8.0f));
-            chessFloorShader.setMat4("model", model);
-            renderQuad();
-        }
+            model = glm::scale(model, glm::vec3(20.0f));
+            renderQueue.submitArrays(baseShader, &baseMaterial, quadVertexArray(), GL_TRIANGLES, 0, 6, model);
 
-        diffZ = -30.0f;
-        for(int i = 0; i < 2; i++){
-            diffZ += 20.0f;
-            glm::mat4 model = glm::mat4(1.0f);
-            model = glm::translate(model, glm::vec3(-10.0f, 0.1f, diffZ));
-            model = glm::rotate(model, float(-1.5708f),glm::vec3(1.0f, 0.0f, 0.0f));
-            model = glm::scale(model, glm::vec3(8.0f));
-            chessFloorShader.setMat4("model", model);
-            renderQuad();
-        }
 
+            // kvadar osnove
 
+            glm::mat4 model_cube = glm::mat4(1.0f);
+            model_cube = glm::translate(model_cube, glm::vec3(0.0f, -0.32f, 0.0f));
+            model_cube = glm::scale(model_cube, glm::vec3(20.0f, 0.3f, 20.0f));
+            renderQueue.submit(cubeMesh, modelLightingShader, model_cube);
 
 
+            // podloga sa teksturom sahovskog polja (implementiran normal mapping)
+
+            renderQueue.submitInstanced(boardModel, chessFloorShader, boardTransforms);
+
+
+            // skybox cube, after everything opaque with the depth test passing at the far plane (see RenderPass::Sky)
+            renderQueue.submitArrays(skyboxShader, &skyboxMaterial, skyboxVAO, GL_TRIANGLES, 0, 36, glm::mat4(1.0f),
+                                     RenderPass::Sky);
+
+            renderQueue.execute();
 
-        glDepthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
-        skyboxShader.use();
-        view = glm::mat4(glm::mat3(programState->camera.GetViewMatrix())); // remove translation from the view matrix
-        skyboxShader.setMat4("view", view);
-        skyboxShader.setMat4("projection", projection);
-        // skybox cube
-        glBindVertexArray(skyboxVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
-        glDepthFunc(GL_LESS); // set depth function back to default
 
+            if (programState->ImGuiEnabled) {
+                DrawImGui(programState);
+                // the ImGui backend puts back the state it changes, but behind glState's back
+                glState.invalidate();
+            }
+            glState.endFrame();
 
-        if (programState->ImGuiEnabled)
-            DrawImGui(programState);
 
 
 
 
+            // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
+            // -------------------------------------------------------------------------------
+            glfwSwapBuffers(window);
+            glfwPollEvents();
 
-        // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
-        // -------------------------------------------------------------------------------
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+            if (firstFrame) {
+                std::cout << "First frame after " << glfwGetTime() * 1000.0 << " ms" << std::endl;
+                firstFrame = false;
+            }
+        }
     }
 
 
@@ -712,97 +710,33 @@ int main() {
 }
 
 // cubemap za skybox
+// the faces are decoded in the background, the skybox stays black until all six are uploaded
 
-unsigned int loadCubemap(vector<std::string> faces)
+unsigned int loadCubemap(TextureStreamer &streamer, vector<std::string> faces)
 {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-    int width, height, nrChannels;
-    for (unsigned int i = 0; i < faces.size(); i++)
-    {
-        unsigned char *data = stbi_load(faces[i].c_str(), &width, &height,
-                                        &nrChannels, 0);
-        if (data)
-        {
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB,
-                         width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-            stbi_image_free(data);
-        }
-        else
-        {
-            std::cout << "Cubemap failed to load at path: " << faces[i]
-                      << std::endl;
-            stbi_image_free(data);
-        }
-    }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S,
-                    GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T,
-                    GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R,
-                    GL_CLAMP_TO_EDGE);
-    return textureID;
+    return streamer.loadCubemap(faces);
 }
 
 
 
 // funkcija za ucitavanje teksture
+// textures already in the cache are shared, new ones return a placeholder that TextureStreamer::update fills in
 // ---------------------------------------------------
-unsigned int loadTexture(char const * path, bool gammaCorrection)
+// the role picks the GPU format; only colour textures are gamma corrected, the others hold data
+unsigned int loadTexture(TextureCache &textures, char const * path, TextureRole role)
 {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum internalFormat;
-        GLenum dataFormat;
-        if (nrComponents == 1)
-        {
-            internalFormat = dataFormat = GL_RED;
-        }
-        else if (nrComponents == 3)
-        {
-            internalFormat = gammaCorrection ? GL_SRGB : GL_RGB;
-            dataFormat = GL_RGB;
-        }
-        else if (nrComponents == 4)
-        {
-            internalFormat = gammaCorrection ? GL_SRGB_ALPHA : GL_RGBA;
-            dataFormat = GL_RGBA;
-        }
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, dataFormat, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
-
-    return textureID;
+    TextureSettings settings;
+    settings.role = role;
+    settings.srgb = role == TextureRole::Albedo;
+    return textures.acquire(path, settings);
 }
 
-// renderQuad za normall mapping
-// renders a 1x1 quad in NDC with manually calculated tangent vectors
+// quad za normall mapping
+// vertex array of a 1x1 quad in NDC with manually calculated tangent vectors, 6 vertices drawn as GL_TRIANGLES
 // ------------------------------------------------------------------
 unsigned int quadVAO = 0;
 unsigned int quadVBO;
-void renderQuad()
+unsigned int quadVertexArray()
 {
     if (quadVAO == 0)
     {
@@ -871,8 +805,8 @@ void renderQuad()
         // configure plane VAO
         glGenVertexArrays(1, &quadVAO);
         glGenBuffers(1, &quadVBO);
-        glBindVertexArray(quadVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+        glState.bindVertexArray(quadVAO);
+        glState.bindBuffer(GL_ARRAY_BUFFER, quadVBO);
         glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
         glEnableVertexAttribArray(0);
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 14 * sizeof(float), (void*)0);
@@ -884,10 +818,9 @@ void renderQuad()
         glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, 14 * sizeof(float), (void*)(8 * sizeof(float)));
         glEnableVertexAttribArray(4);
         glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, 14 * sizeof(float), (void*)(11 * sizeof(float)));
+        glState.bindVertexArray(0);
     }
-    glBindVertexArray(quadVAO);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
-    glBindVertexArray(0);
+    return quadVAO;
 }
 
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
@@ -985,6 +918,8 @@ void DrawImGui(ProgramState *programState) {
         ImGui::DragFloat("pointLight.constant", &programState->pointLight.constant, 0.05, 0.0, 1.0);
         ImGui::DragFloat("pointLight.linear", &programState->pointLight.linear, 0.05, 0.0, 1.0);
         ImGui::DragFloat("pointLight.quadratic", &programState->pointLight.quadratic, 0.05, 0.0, 1.0);
+        const GLStateStats &stateCalls = glState.lastFrame();
+        ImGui::Text("GL state calls last frame: %lu made, %lu skipped", stateCalls.issued, stateCalls.elided);
         ImGui::End();
     }
 
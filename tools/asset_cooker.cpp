@@ -0,0 +1,230 @@
+// offline texture cooker: converts the project's images into block compressed textures with a precomputed mip chain
+// (see learnopengl/cooked_texture.h). the game picks the cooked files up automatically, so run this from the project
+// root after adding or changing textures:
+//
+//     ./asset_cooker                      cooks resources/textures and resources/objects
+//     ./asset_cooker <file or directory>...
+//
+// the format follows the texture's role, guessed from its file name and stored with it: normal maps become two
+// channel BC5, height/bump, roughness, occlusion and specular maps single channel BC4, images with transparency BC3
+// and everything else BC1. the game decodes the source instead when it loads the texture in a role the codec
+// doesn't fit. the colour (BC1/BC3) textures are cooked twice, with mips for sampling as sRGB and as stored. 16 bit
+// height maps are left alone, the game keeps their full precision in an R16 texture (see ChooseTextureFormat).
+#include <learnopengl/cooked_texture.h>
+#include <learnopengl/image.h>
+#include <learnopengl/texture_compression.h>
+#include <learnopengl/thread_pool.h>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <future>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+using namespace std;
+
+struct CookResult {
+    bool cooked = false;
+    bool upToDate = false;
+    bool skipped = false;
+    size_t uncompressedBytes = 0;   // RGBA8 with a full mip chain, what the runtime would otherwise upload
+    size_t cookedBytes = 0;
+};
+
+static mutex outputMutex;
+
+static string lowercase(string text)
+{
+    transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return (char)tolower(c); });
+    return text;
+}
+
+static bool isImage(const string &path)
+{
+    string name = lowercase(path);
+    for (const char *extension : {".jpg", ".jpeg", ".png", ".tga", ".bmp"})
+    {
+        size_t length = strlen(extension);
+        if (name.size() > length && name.compare(name.size() - length, length, extension) == 0)
+            return true;
+    }
+    return false;
+}
+
+static bool isDirectory(const string &path)
+{
+    struct stat info;
+    return stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+}
+
+// cube map faces are loaded uncompressed without mips, cooking them would only waste disk space
+static void collectImages(const string &path, vector<string> &images)
+{
+    if (!isDirectory(path))
+    {
+        if (isImage(path))
+            images.push_back(path);
+        return;
+    }
+    DIR *directory = opendir(path.c_str());
+    if (!directory)
+        return;
+    vector<string> entries;
+    while (dirent *entry = readdir(directory))
+    {
+        string name = entry->d_name;
+        if (name != "." && name != ".." && lowercase(name) != "skybox")
+            entries.push_back(path + '/' + name);
+    }
+    closedir(directory);
+    sort(entries.begin(), entries.end());
+    for (const string &entry : entries)
+        collectImages(entry, images);
+}
+
+// the role the game will most likely load a texture with, guessed once from its file name
+static TextureRole guessRole(const string &path)
+{
+    string name = lowercase(path.substr(path.find_last_of('/') + 1));
+    if (name.find("normal") != string::npos)
+        return TextureRole::Normal;
+    if (name.find("height") != string::npos || name.find("bump") != string::npos || name.find("disp") != string::npos)
+        return TextureRole::Height;
+    if (name.find("rough") != string::npos)
+        return TextureRole::Roughness;
+    if (name.find("occlusion") != string::npos || name.find("_ao") != string::npos)
+        return TextureRole::AmbientOcclusion;
+    if (name.find("spec") != string::npos)
+        return TextureRole::Specular;
+    return TextureRole::Albedo;
+}
+
+static TextureCodec chooseCodec(TextureRole role, const DecodedImage &image)
+{
+    if (role == TextureRole::Normal)
+        return TextureCodec::BC5;
+    if (role != TextureRole::Albedo)
+        return TextureCodec::BC4;
+    const unsigned char *pixels = image.pixels.get();
+    for (size_t i = 3; i < image.size(); i += 4)
+        if (pixels[i] != 255)
+            return TextureCodec::BC3;
+    return TextureCodec::BC1;
+}
+
+// one cooked file of a texture: colour textures are cooked once with mips averaged as stored and once averaged in
+// linear light, the game takes the one matching how it samples the texture (see TextureSettings::srgb)
+static bool cookVariant(const string &path, const DecodedImage &image, uint64_t hash, TextureRole role, bool srgb,
+                        CookResult &result)
+{
+    TextureCodec codec = chooseCodec(role, image);
+    MipFilter filter = codec == TextureCodec::BC5 ? MipFilter::NormalMap : srgb ? MipFilter::Srgb : MipFilter::Linear;
+    vector<unsigned char> rgba(image.pixels.get(), image.pixels.get() + image.size());
+    vector<CompressedLevel> levels = CompressMipChain(std::move(rgba), image.width, image.height, codec, filter);
+
+    size_t uncompressedBytes = 0, cookedBytes = 0;
+    for (const CompressedLevel &level : levels)
+    {
+        uncompressedBytes += (size_t)level.width * level.height * 4;
+        cookedBytes += level.data.size();
+    }
+    result.uncompressedBytes += uncompressedBytes;
+    result.cookedBytes += cookedBytes;
+    bool written = CookedTextureCache::write(CookedTextureCache::cachePath(hash, srgb), hash, codec, role, true, srgb, levels);
+
+    ostringstream line;
+    line << "COOKER:: " << path << " -> " << TextureCodecName(codec) << (srgb ? " (sRGB mips)" : "") << ", "
+         << image.width << "x" << image.height << ", " << levels.size() << " levels, "
+         << uncompressedBytes / (1024 * 1024) << " MB -> " << cookedBytes / 1024 << " KB" << (written ? "" : " (writing failed)");
+    lock_guard<mutex> lock(outputMutex);
+    cout << line.str() << endl;
+    return written;
+}
+
+static CookResult cookTexture(const string &path)
+{
+    CookResult result;
+    TextureRole role = guessRole(path);
+    if (role == TextureRole::Height && IsSixteenBitPng(path))
+    {
+        result.skipped = true;
+        lock_guard<mutex> lock(outputMutex);
+        cout << "COOKER:: " << path << " kept as 16 bit source" << endl;
+        return result;
+    }
+    uint64_t hash = CookedTextureCache::sourceHash(path);
+    // the game loads every texture flipped, the cooked rows have to match
+    DecodedImage image;
+    bool upToDate = true;
+    // only colour textures are ever sampled as sRGB
+    bool colour = role == TextureRole::Albedo;
+    for (bool srgb : {false, true})
+    {
+        if (srgb && !colour)
+            continue;
+        string cookedPath = CookedTextureCache::cachePath(hash, srgb);
+        CookedTextureView existing;
+        if (CookedTextureCache::open(cookedPath, hash, existing))
+            continue;
+        if (!image.pixels)
+            image = DecodeImage(path, true, 4);
+        if (!image.pixels)
+        {
+            lock_guard<mutex> lock(outputMutex);
+            cout << "COOKER:: failed to load " << path << endl;
+            return result;
+        }
+        upToDate = false;
+        if (!cookVariant(path, image, hash, role, srgb, result))
+            return result;
+    }
+    result.upToDate = upToDate;
+    result.cooked = !upToDate;
+    return result;
+}
+
+int main(int argc, char **argv)
+{
+    vector<string> roots;
+    for (int i = 1; i < argc; i++)
+        roots.push_back(argv[i]);
+    if (roots.empty())
+        roots = {"resources/textures", "resources/objects"};
+
+    vector<string> images;
+    for (const string &root : roots)
+        collectImages(root, images);
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    // every worker plus this thread, which only waits
+    ThreadPool pool(ThreadPool::defaultThreadCount() + 1);
+    vector<future<CookResult>> results;
+    for (const string &image : images)
+        results.push_back(pool.submit([image] { return cookTexture(image); }));
+
+    unsigned int cooked = 0, upToDate = 0, skipped = 0, failed = 0;
+    size_t uncompressedBytes = 0, cookedBytes = 0;
+    for (future<CookResult> &pending : results)
+    {
+        CookResult result = pending.get();
+        cooked += result.cooked;
+        upToDate += result.upToDate;
+        skipped += result.skipped;
+        failed += !result.cooked && !result.upToDate && !result.skipped;
+        uncompressedBytes += result.uncompressedBytes;
+        cookedBytes += result.cookedBytes;
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "COOKER:: " << cooked << " textures cooked (" << uncompressedBytes / (1024 * 1024) << " MB -> "
+         << cookedBytes / (1024 * 1024) << " MB of VRAM), " << upToDate << " up to date, " << skipped << " skipped, " << failed << " failed in "
+         << seconds << " s" << endl;
+    return failed ? 1 : 0;
+}